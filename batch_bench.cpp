@@ -0,0 +1,102 @@
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "board_batch.hpp"
+#include "perft.hpp"
+
+// Positions per second of perft 1 and 2 over many independent positions: count_root per position against the batch
+// kernels at every lane width the target supports. The counts of every method are checked against count_root.
+
+const std::vector<std::string> walk_fens = {
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+	"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+	"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+	"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+};
+
+// Random positions reached by random play from the suite.
+static std::vector<Position> random_positions(size_t n, uint64_t seed) {
+	std::mt19937_64 rng(seed);
+	std::vector<Position> ret;
+	MoveBuffer moves;
+	while (ret.size() < n) {
+		Position pos;
+		pos.load_fen(walk_fens[rng() % walk_fens.size()]);
+		int plies = rng() % 40;
+		for (int i = 0; i < plies; i++) {
+			pyke::generate_legal_moves(pos, moves);
+			if (!moves.size()) break;
+			pyke::make_move(pos, moves[rng() % moves.size()]);
+		}
+		ret.push_back(pos);
+	}
+	return ret;
+}
+
+static double seconds_of(const std::function<void()>& f) {
+	auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+	size_t n = 200000;
+	uint64_t seed = 0x5eed;
+	std::vector<int> depths = {1, 2};
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--positions" && i + 1 < argc) {
+			n = std::stoull(argv[++i]);
+		} else if (arg == "--seed" && i + 1 < argc) {
+			seed = std::stoull(argv[++i]);
+		} else if (arg == "--depth" && i + 1 < argc) {
+			depths = {std::stoi(argv[++i])};
+		} else {
+			std::cout << "Usage: batch_bench [--positions N] [--seed N] [--depth D]\n";
+			return 1;
+		}
+	}
+
+	std::vector<Position> positions = random_positions(n, seed);
+	int failures = 0;
+	std::cout << std::left << std::setw(24) << "method" << std::right << std::setw(8) << "depth" << std::setw(16)
+			  << "positions/s" << std::setw(16) << "nodes/s" << '\n';
+	for (int depth : depths) {
+		std::vector<NodeCount> expected(n);
+		NodeCount nodes = 0;
+		auto report = [&](const std::string& name, double s, const std::vector<NodeCount>& counts) {
+			bool ok = counts == expected;
+			failures += !ok;
+			std::cout << std::left << std::setw(24) << name << std::right << std::setw(8) << depth << std::setw(16)
+					  << std::fixed << std::setprecision(0) << n / s << std::setw(16) << nodes / s
+					  << (ok ? "" : "  MISMATCH") << '\n';
+		};
+
+		double s = seconds_of([&] {
+			for (size_t i = 0; i < n; i++) expected[i] = count_root(positions[i], depth);
+		});
+		for (NodeCount c : expected) nodes += c;
+		report("count_root", s, expected);
+
+		std::vector<NodeCount> counts;
+		s = seconds_of([&] { counts = batch::batch_perft<U64x1>(positions, depth); });
+		report("batch scalar", s, counts);
+#ifdef __AVX2__
+		s = seconds_of([&] { counts = batch::batch_perft<U64x4>(positions, depth); });
+		report("batch avx2 (4 lanes)", s, counts);
+#endif
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+		s = seconds_of([&] { counts = batch::batch_perft<U64x8>(positions, depth); });
+		report("batch avx512 (8 lanes)", s, counts);
+#endif
+	}
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,98 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "frontier.hpp"
+#include "perft.hpp"
+
+// Runs the level synchronous perft and reports the size of each frontier level before and after merging
+// transpositions. With --check the result is compared against the depth first count_root.
+
+const std::string start_fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+int main(int argc, char* argv[]) {
+	std::string fen = start_fen;
+	int depth = 6;
+	bool check = false;
+	FrontierConfig config;
+	config.threads = std::max(1u, std::thread::hardware_concurrency());
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--depth" && i + 1 < argc) {
+			depth = std::stoi(argv[++i]);
+		} else if (arg == "--fen" && i + 1 < argc) {
+			fen = argv[++i];
+		} else if (arg == "--threads" && i + 1 < argc) {
+			config.threads = std::stoi(argv[++i]);
+		} else if (arg == "--pin" && i + 1 < argc) {
+			config.pin = parse_pin_policy(argv[++i]);
+		} else if (arg == "--finish" && i + 1 < argc) {
+			config.finish_depth = std::stoi(argv[++i]);
+		} else if (arg == "--partitions" && i + 1 < argc) {
+			config.partitions = std::stoi(argv[++i]);
+		} else if (arg == "--memory" && i + 1 < argc) {
+			config.memory_budget = std::stoull(argv[++i]) << 20;
+		} else if (arg == "--spill" && i + 1 < argc) {
+			config.spill_dir = argv[++i];
+		} else if (arg == "--counters") {
+			config.counters = true;
+		} else if (arg == "--check") {
+			check = true;
+		} else {
+			std::cout << "Usage: bfs_perft [--depth N] [--fen FEN] [--threads N] [--pin POLICY] [--finish N] "
+						 "[--partitions N] [--memory MB] [--spill DIR] [--counters] [--check]\n";
+			return 1;
+		}
+	}
+
+	Position pos;
+	try {
+		pos.load_fen(fen);
+	} catch (const std::invalid_argument& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	FrontierResult result;
+	try {
+		result = frontier_perft(pos, depth, config);
+	} catch (const std::runtime_error& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	for (const FrontierLevel& l : result.levels) {
+		std::cout << "ply " << l.ply << ": " << l.positions << " positions, " << l.unique << " unique ("
+				  << (l.unique ? double(l.positions) / l.unique : 0) << "x), " << l.spilled_bytes / (1 << 20)
+				  << " MB spilled, " << l.seconds << " s\n";
+	}
+	std::cout << "Nodes: " << result.nodes << "\nTime: " << seconds << " s, "
+			  << (seconds > 0 ? result.nodes / seconds / 1e6 : 0) << " million nodes per second\nThreads: "
+			  << result.placement << '\n';
+	if (config.counters) {
+		CounterValues total;
+		for (size_t t = 0; t < result.thread_counters.size(); t++) {
+			std::cout << "thread " << t << ": " << counter_summary(result.thread_counters[t]) << '\n';
+			total += result.thread_counters[t];
+		}
+		print_counters(std::cout, total, result.nodes, seconds);
+	}
+
+	if (check) {
+		start = std::chrono::steady_clock::now();
+		NodeCount expected = count_root(pos, depth);
+		seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "count_root: " << expected << " in " << seconds << " s\n";
+		if (expected != result.nodes) {
+			std::cout << "MISMATCH\n";
+			return 1;
+		}
+	}
+	return 0;
+}
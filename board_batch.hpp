@@ -0,0 +1,282 @@
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "movegen.hpp"
+#include "position.hpp"
+#include "pyke.hpp"
+#include "simd.hpp"
+
+#ifndef BOARD_BATCH_H
+#define BOARD_BATCH_H
+
+// Positions in structure of arrays form, one lane per position, for counting legal moves of many positions at once.
+// Boards are stored from the side to move, which always moves up the board: positions with black to move are mirrored
+// vertically with the colors swapped. Empty lanes have no pieces and count zero moves.
+template <int lanes>
+struct BoardBatch {
+	// Indexed by piece - 1.
+	alignas(64) uint64_t us[6][lanes] = {};
+	alignas(64) uint64_t them[6][lanes] = {};
+	// Rooks on a1 and h1 that still have their castling right.
+	alignas(64) uint64_t castle[lanes] = {};
+	// Legal ep captures, tested on load: they are rare and need the move to be made to test for discovered checks.
+	NodeCount ep_moves[lanes] = {};
+
+	void set(int lane, Position& pos) {
+		bool white = pos.white_turn;
+		for (Piece p = PAWN; p <= QUEEN; p++) {
+			BitBoard own = *pos.board.get_board_pointer(white, p);
+			BitBoard opp = *pos.board.get_board_pointer(!white, p);
+			us[p - 1][lane] = white ? own : __builtin_bswap64(own);
+			them[p - 1][lane] = white ? opp : __builtin_bswap64(opp);
+		}
+		CastlingRights cr = pos.castling_rights;
+		castle[lane] = ((white ? get_cr_wk(cr) : get_cr_bk(cr)) ? square_to_mask(63) : 0)
+			| ((white ? get_cr_wq(cr) : get_cr_bq(cr)) ? square_to_mask(56) : 0);
+
+		uint8_t ep = pos.ep_flag;
+		ep_moves[lane] = 0;
+		if (ep & 0x80) ep_moves[lane] += white ? pyke::has_ep_move<true, -1>(pos, ep) : pyke::has_ep_move<false, -1>(pos, ep);
+		if (ep & 0x40) ep_moves[lane] += white ? pyke::has_ep_move<true, 1>(pos, ep) : pyke::has_ep_move<false, 1>(pos, ep);
+	}
+
+	void clear(int lane) {
+		for (int p = 0; p < 6; p++) us[p][lane] = them[p][lane] = 0;
+		castle[lane] = 0;
+		ep_moves[lane] = 0;
+	}
+};
+
+namespace batch {
+
+// Directions as a shift and the squares that can not be reached without wrapping around the board.
+struct Direction {
+	int shift;
+	uint64_t keep;
+};
+
+constexpr uint64_t not_a = ~0x8080808080808080ULL;
+constexpr uint64_t not_ab = ~0xC0C0C0C0C0C0C0C0ULL;
+constexpr uint64_t not_h = ~0x0101010101010101ULL;
+constexpr uint64_t not_gh = ~0x0303030303030303ULL;
+
+constexpr Direction north{8, ~0ULL};
+constexpr Direction south{-8, ~0ULL};
+constexpr Direction east{-1, not_a};
+constexpr Direction west{1, not_h};
+constexpr Direction north_east{7, not_a};
+constexpr Direction north_west{9, not_h};
+constexpr Direction south_east{-9, not_a};
+constexpr Direction south_west{-7, not_h};
+
+template <Direction d, typename V>
+static inline V step(V b) {
+	return shift<d.shift>(b) & V::broadcast(d.keep);
+}
+
+// Kogge-Stone fill: squares a slider reaches from gen in direction d, up to and including the first occupied square.
+template <Direction d, typename V>
+static inline V slide(V gen, V empty) {
+	V pro = empty & V::broadcast(d.keep);
+	gen = gen | (pro & shift<d.shift>(gen));
+	pro = pro & shift<d.shift>(pro);
+	gen = gen | (pro & shift<2 * d.shift>(gen));
+	pro = pro & shift<2 * d.shift>(pro);
+	gen = gen | (pro & shift<4 * d.shift>(gen));
+	return step<d>(gen);
+}
+
+template <typename V>
+static inline V knight_attacks(V b) {
+	return step<Direction{15, not_a}>(b) | step<Direction{17, not_h}>(b) | step<Direction{6, not_ab}>(b)
+		| step<Direction{10, not_gh}>(b) | step<Direction{-17, not_a}>(b) | step<Direction{-15, not_h}>(b)
+		| step<Direction{-10, not_ab}>(b) | step<Direction{-6, not_gh}>(b);
+}
+
+// Knight moves counted per jump direction, as jumps of several knights can share a target square.
+template <typename V>
+static inline V count_knight_moves(V b, V target) {
+	return popcount(step<Direction{15, not_a}>(b) & target) + popcount(step<Direction{17, not_h}>(b) & target)
+		+ popcount(step<Direction{6, not_ab}>(b) & target) + popcount(step<Direction{10, not_gh}>(b) & target)
+		+ popcount(step<Direction{-17, not_a}>(b) & target) + popcount(step<Direction{-15, not_h}>(b) & target)
+		+ popcount(step<Direction{-10, not_ab}>(b) & target) + popcount(step<Direction{-6, not_gh}>(b) & target);
+}
+
+template <typename V>
+static inline V king_attacks(V b) {
+	return step<north>(b) | step<south>(b) | step<east>(b) | step<west>(b) | step<north_east>(b)
+		| step<north_west>(b) | step<south_east>(b) | step<south_west>(b);
+}
+
+// Pushes, double pushes and captures of the given pawns onto target, with four moves per promotion.
+template <typename V>
+static inline V count_pawn_moves(V pawns, V target, V empty, V opp) {
+	const V rank_3 = V::broadcast(0x0000000000FF0000ULL);
+	const V rank_8 = V::broadcast(0xFF00000000000000ULL);
+	V push = step<north>(pawns) & empty;
+	V push_double = step<north>(push & rank_3) & empty & target;
+	push = push & target;
+	V left = step<north_west>(pawns) & opp & target;
+	V right = step<north_east>(pawns) & opp & target;
+	V promotions = popcount(push & rank_8) + popcount(left & rank_8) + popcount(right & rank_8);
+	return popcount(push) + popcount(left) + popcount(right) + popcount(push_double) + promotions + promotions
+		+ promotions;
+}
+
+// Check and pin rays of one direction from the king.
+template <Direction d, typename V>
+static inline void scan_ray(V king, V own, V empty, V sliders, V& check_mask, V& checkers, V& pins) {
+	const V ones = V::broadcast(~0ULL);
+	V ray = slide<d>(king, empty);
+	V checking = andnot(ones, is_zero(ray & sliders));
+	check_mask = check_mask | (ray & checking);
+	checkers = checkers + (checking & V::broadcast(1));
+
+	V behind = slide<d>(ray & own, empty);
+	V pinning = andnot(ones, is_zero(behind & sliders));
+	pins = pins | ((ray | behind) & pinning);
+}
+
+// Counts the legal moves of every lane. Follows count_moves: king moves against the attacked squares with the king
+// lifted, then pinned and unpinned pieces against the check and pin masks, skipped in double check.
+template <typename V>
+static inline void count_leaves(const BoardBatch<V::lanes>& batch, NodeCount* out) {
+	const V ones = V::broadcast(~0ULL);
+	V pawn = V::load(batch.us[PAWN - 1]), king = V::load(batch.us[KING - 1]), rook = V::load(batch.us[ROOK - 1]);
+	V bishop = V::load(batch.us[BISHOP - 1]), knight = V::load(batch.us[KNIGHT - 1]);
+	V queen = V::load(batch.us[QUEEN - 1]);
+	V opp_pawn = V::load(batch.them[PAWN - 1]), opp_king = V::load(batch.them[KING - 1]);
+	V opp_knight = V::load(batch.them[KNIGHT - 1]), opp_queen = V::load(batch.them[QUEEN - 1]);
+	V opp_orth = V::load(batch.them[ROOK - 1]) | opp_queen;
+	V opp_diag = V::load(batch.them[BISHOP - 1]) | opp_queen;
+
+	V own = pawn | king | rook | bishop | knight | queen;
+	V opp = opp_pawn | opp_king | opp_knight | opp_orth | opp_diag;
+	V empty = andnot(ones, own | opp);
+
+	// Attacked squares, with the king lifted so it can not hide behind itself on a checking ray.
+	V empty_nk = empty | king;
+	V attacked = step<south_east>(opp_pawn) | step<south_west>(opp_pawn) | knight_attacks(opp_knight)
+		| king_attacks(opp_king) | slide<north>(opp_orth, empty_nk) | slide<south>(opp_orth, empty_nk)
+		| slide<east>(opp_orth, empty_nk) | slide<west>(opp_orth, empty_nk) | slide<north_east>(opp_diag, empty_nk)
+		| slide<north_west>(opp_diag, empty_nk) | slide<south_east>(opp_diag, empty_nk)
+		| slide<south_west>(opp_diag, empty_nk);
+	V ret = popcount(andnot(king_attacks(king), own | attacked));
+
+	// Checks and pins.
+	V check_mask = (knight_attacks(king) & opp_knight) | ((step<north_west>(king) | step<north_east>(king)) & opp_pawn);
+	V checkers = popcount(check_mask);
+	V pin_orth = V::broadcast(0), pin_diag = V::broadcast(0);
+	scan_ray<north>(king, own, empty, opp_orth, check_mask, checkers, pin_orth);
+	scan_ray<south>(king, own, empty, opp_orth, check_mask, checkers, pin_orth);
+	scan_ray<east>(king, own, empty, opp_orth, check_mask, checkers, pin_orth);
+	scan_ray<west>(king, own, empty, opp_orth, check_mask, checkers, pin_orth);
+	scan_ray<north_east>(king, own, empty, opp_diag, check_mask, checkers, pin_diag);
+	scan_ray<north_west>(king, own, empty, opp_diag, check_mask, checkers, pin_diag);
+	scan_ray<south_east>(king, own, empty, opp_diag, check_mask, checkers, pin_diag);
+	scan_ray<south_west>(king, own, empty, opp_diag, check_mask, checkers, pin_diag);
+
+	V no_check = is_zero(checkers);
+	V target = andnot(ones, own) & (check_mask | no_check);
+	V target_orth = target & pin_orth;
+	V target_diag = target & pin_diag;
+	V nopin = andnot(ones, pin_orth | pin_diag);
+
+	// Sliders. Rays of several pieces in one direction end at the first piece, so they never share a square.
+	V orth = (rook | queen) & nopin;
+	V diag = (bishop | queen) & nopin;
+	V orth_pinned = (rook | queen) & andnot(pin_orth, pin_diag);
+	V diag_pinned = (bishop | queen) & andnot(pin_diag, pin_orth);
+	V moves = count_knight_moves(knight & nopin, target);
+	moves = moves + popcount(slide<north>(orth, empty) & target) + popcount(slide<north>(orth_pinned, empty) & target_orth);
+	moves = moves + popcount(slide<south>(orth, empty) & target) + popcount(slide<south>(orth_pinned, empty) & target_orth);
+	moves = moves + popcount(slide<east>(orth, empty) & target) + popcount(slide<east>(orth_pinned, empty) & target_orth);
+	moves = moves + popcount(slide<west>(orth, empty) & target) + popcount(slide<west>(orth_pinned, empty) & target_orth);
+	moves = moves + popcount(slide<north_east>(diag, empty) & target)
+		+ popcount(slide<north_east>(diag_pinned, empty) & target_diag);
+	moves = moves + popcount(slide<north_west>(diag, empty) & target)
+		+ popcount(slide<north_west>(diag_pinned, empty) & target_diag);
+	moves = moves + popcount(slide<south_east>(diag, empty) & target)
+		+ popcount(slide<south_east>(diag_pinned, empty) & target_diag);
+	moves = moves + popcount(slide<south_west>(diag, empty) & target)
+		+ popcount(slide<south_west>(diag_pinned, empty) & target_diag);
+	moves = moves + count_pawn_moves(pawn & nopin, target, empty, opp)
+		+ count_pawn_moves(pawn & pin_diag, target_diag, empty, opp)
+		+ count_pawn_moves(pawn & pin_orth, target_orth, empty, opp);
+
+	// Castling, through squares that are empty and not attacked.
+	V castle = V::load(batch.castle);
+	V blocked = andnot(ones, empty) | attacked;
+	V kingside = andnot(ones, is_zero(castle & V::broadcast(square_to_mask(63))))
+		& is_zero(blocked & V::broadcast(square_to_mask(61) | square_to_mask(62)));
+	V queenside = andnot(ones, is_zero(castle & V::broadcast(square_to_mask(56))))
+		& is_zero(andnot(ones, empty) & V::broadcast(square_to_mask(57)))
+		& is_zero(blocked & V::broadcast(square_to_mask(58) | square_to_mask(59)));
+	moves = moves + (kingside & no_check & V::broadcast(1)) + (queenside & no_check & V::broadcast(1));
+
+	// Only the king moves in double check.
+	ret = ret + andnot(moves, andnot(ones, is_zero(andnot(checkers, V::broadcast(1)))));
+
+	alignas(64) uint64_t counts[V::lanes];
+	ret.store(counts);
+	for (int i = 0; i < V::lanes; i++) out[i] = counts[i] + batch.ep_moves[i];
+}
+
+// Collects positions and counts their legal moves a full batch at a time. Each count is added to the total of the
+// position's owner.
+template <typename V>
+struct LeafCounter {
+	BoardBatch<V::lanes> batch;
+	size_t owners[V::lanes];
+	int used = 0;
+	NodeCount* totals;
+
+	explicit LeafCounter(NodeCount* totals) : totals(totals) {}
+
+	void add(Position& pos, size_t owner) {
+		batch.set(used, pos);
+		owners[used++] = owner;
+		if (used == V::lanes) flush();
+	}
+
+	void flush() {
+		if (!used) return;
+		for (int i = used; i < V::lanes; i++) batch.clear(i);
+		NodeCount counts[V::lanes];
+		count_leaves<V>(batch, counts);
+		for (int i = 0; i < used; i++) totals[owners[i]] += counts[i];
+		used = 0;
+	}
+};
+
+template <typename V>
+static void expand(Position& pos, int depth, size_t owner, LeafCounter<V>& counter) {
+	if (depth == 1) {
+		counter.add(pos, owner);
+		return;
+	}
+	MoveBuffer moves;
+	pyke::generate_legal_moves(pos, moves);
+	for (Move m : moves) {
+		MoveUndo undo = pyke::make_move(pos, m);
+		expand(pos, depth - 1, owner, counter);
+		pyke::unmake_move(pos, m, undo);
+	}
+}
+
+// Perft of many independent positions. The last ply is counted by the batch kernel, the plies above it are made with
+// generate_legal_moves, so lanes are filled across positions.
+template <typename V = U64xN>
+static std::vector<NodeCount> batch_perft(std::vector<Position>& positions, int depth) {
+	std::vector<NodeCount> totals(positions.size(), depth <= 0 ? 1 : 0);
+	if (depth <= 0) return totals;
+	LeafCounter<V> counter(totals.data());
+	for (size_t i = 0; i < positions.size(); i++) expand(positions[i], depth, i, counter);
+	counter.flush();
+	return totals;
+}
+
+};	// namespace batch
+
+#endif
@@ -45,6 +45,9 @@ constexpr uint64_t INIT_WHITE_PIECES = 0b000000000000000000000000000000000000000
 
 enum class PawnMoveType { ATTACKS, FORWARD, DOUBLE_FORWARD, NON_DOUBLE, ALL };
 
+// Outcome of a position for the side to move.
+enum class GameResult { ONGOING, CHECKMATE, STALEMATE };
+
 const std::unordered_map<Square, uint8_t> get_castle_code{{62, 0}, {58, 1}, {6, 2}, {2, 3}};
 
 inline constexpr BitBoard promotion_to_squares = (0b1111'1111ULL) | (0b1111'1111ULL << 56);
@@ -59,6 +62,7 @@ inline constexpr uint8_t king_end_squares[4] = {62, 58, 6, 2};
 inline constexpr uint8_t rook_end_squares[4] = {61, 59, 5, 3};
 inline constexpr uint8_t queenside_middle_squares[4] = {1, 57};
 
+inline constexpr std::array<Piece, 4> promotion_pieces = {QUEEN, ROOK, BISHOP, KNIGHT};
 inline constexpr std::array<Piece, 6> non_king_pieces = {PAWN, KNIGHT, BISHOP, ROOK, QUEEN, EMPTY};
 inline constexpr std::array<Piece, 7> pieces = {PAWN, KING, KNIGHT, BISHOP, ROOK, QUEEN, EMPTY};
 inline constexpr BitBoard no_edges = 0b0111'1110'0111'1110'0111'1110'0111'1110'0111'1110'0111'1110'0111'1110'0111'1110;
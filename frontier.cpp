@@ -0,0 +1,190 @@
+#include "frontier.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "movegen.hpp"
+#include "perft.hpp"
+#include "thread_pool.hpp"
+
+// Child entries a thread collects per partition before taking the partition lock.
+constexpr size_t flush_entries = 1024;
+
+// One hash partition of a level. Entries come from all threads; the ones that did not fit the memory budget are in the
+// spill file.
+struct Partition {
+	std::mutex mutex;
+	std::vector<FrontierEntry> entries;
+	std::string path;
+	uint64_t spilled = 0;
+
+	~Partition() {
+		if (spilled) std::remove(path.c_str());
+	}
+};
+
+struct Level {
+	std::vector<std::unique_ptr<Partition>> partitions;
+	std::atomic<uint64_t> positions = 0;
+	std::atomic<uint64_t> spilled_bytes = 0;
+};
+
+struct FrontierRun {
+	const FrontierConfig& config;
+	unsigned partitions;
+	std::string spill_prefix;
+	std::atomic<size_t> in_memory = 0;
+};
+
+static std::unique_ptr<Level> make_level(FrontierRun& run, int ply) {
+	auto level = std::make_unique<Level>();
+	for (unsigned p = 0; p < run.partitions; p++) {
+		level->partitions.push_back(std::make_unique<Partition>());
+		level->partitions.back()->path = run.spill_prefix + std::to_string(ply) + '_' + std::to_string(p) + ".bin";
+	}
+	return level;
+}
+
+// Moves the buffered entries into partition p. Spills the partition when the budget is exceeded.
+static void append(FrontierRun& run, Level& level, unsigned p, std::vector<FrontierEntry>& buffer) {
+	Partition& part = *level.partitions[p];
+	size_t bytes = buffer.size() * sizeof(FrontierEntry);
+	level.positions += buffer.size();
+
+	std::lock_guard<std::mutex> lock(part.mutex);
+	part.entries.insert(part.entries.end(), buffer.begin(), buffer.end());
+	buffer.clear();
+	if ((run.in_memory += bytes) <= run.config.memory_budget) return;
+
+	size_t held = part.entries.size() * sizeof(FrontierEntry);
+	std::ofstream out(part.path, std::ios::binary | std::ios::app);
+	out.write(reinterpret_cast<const char*>(part.entries.data()), held);
+	if (!out) throw std::runtime_error("Can not write spill file " + part.path);
+	part.spilled += part.entries.size();
+	level.spilled_bytes += held;
+	run.in_memory -= held;
+	std::vector<FrontierEntry>().swap(part.entries);
+}
+
+// Takes all entries of a partition, reading back the spilled ones, and merges the paths of equal positions.
+static std::vector<FrontierEntry> take_merged(FrontierRun& run, Partition& part) {
+	std::vector<FrontierEntry> entries;
+	if (part.spilled) {
+		entries.resize(part.spilled);
+		std::ifstream in(part.path, std::ios::binary);
+		in.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(FrontierEntry));
+		if (!in) throw std::runtime_error("Can not read spill file " + part.path);
+		in.close();
+		std::remove(part.path.c_str());
+		part.spilled = 0;
+	}
+	run.in_memory -= part.entries.size() * sizeof(FrontierEntry);
+	entries.insert(entries.end(), part.entries.begin(), part.entries.end());
+	std::vector<FrontierEntry>().swap(part.entries);
+
+	std::sort(entries.begin(), entries.end(), [](const FrontierEntry& a, const FrontierEntry& b) { return a.pos < b.pos; });
+	size_t unique = 0;
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (unique && entries[unique - 1].pos == entries[i].pos)
+			entries[unique - 1].paths += entries[i].paths;
+		else
+			entries[unique++] = entries[i];
+	}
+	entries.resize(unique);
+	return entries;
+}
+
+// Expands every entry by one ply into the partitions of the next level.
+static void expand(FrontierRun& run, const std::vector<FrontierEntry>& entries, Level& next, Position& pos) {
+	std::vector<std::vector<FrontierEntry>> buffers(run.partitions);
+	MoveBuffer moves;
+	for (const FrontierEntry& e : entries) {
+		unpack_position(e.pos, pos);
+		pyke::generate_legal_moves(pos, moves);
+		for (Move m : moves) {
+			MoveUndo undo = pyke::make_move(pos, m);
+			PackedPosition child = pack_position(pos);
+			pyke::unmake_move(pos, m, undo);
+
+			unsigned p = child.hash() % run.partitions;
+			buffers[p].push_back({child, e.paths});
+			if (buffers[p].size() >= flush_entries) append(run, next, p, buffers[p]);
+		}
+	}
+	for (unsigned p = 0; p < run.partitions; p++) {
+		if (!buffers[p].empty()) append(run, next, p, buffers[p]);
+	}
+}
+
+FrontierResult frontier_perft(Position& pos, int depth, const FrontierConfig& config) {
+	FrontierResult result;
+	if (depth <= 0) {
+		result.nodes = 1;
+		return result;
+	}
+
+	std::filesystem::path dir = config.spill_dir.empty() ? std::filesystem::temp_directory_path()
+														 : std::filesystem::path(config.spill_dir);
+	FrontierRun run{config, std::max(1u, config.partitions),
+					(dir / ("pyke_frontier_" + std::to_string(getpid()) + '_')).string()};
+	int finish = std::clamp(config.finish_depth, 1, depth);
+	// Before the pool, so the pool is gone before its counters.
+	std::unique_ptr<ThreadCounters> counters =
+		config.counters ? std::make_unique<ThreadCounters>(std::max(1u, config.threads)) : nullptr;
+	ThreadPool pool(config.threads, config.pin);
+	pool.attach_counters(counters.get());
+	result.placement = pool.get_placement().describe();
+	std::vector<Position> positions(pool.size());
+
+	std::unique_ptr<Level> current = make_level(run, 0);
+	std::vector<FrontierEntry> root = {{pack_position(pos), 1}};
+	append(run, *current, pack_position(pos).hash() % run.partitions, root);
+
+	for (int ply = 0; ply <= depth - finish; ply++) {
+		auto start = std::chrono::steady_clock::now();
+		bool last = ply == depth - finish;
+		std::unique_ptr<Level> next = last ? nullptr : make_level(run, ply + 1);
+		std::atomic<uint64_t> unique = 0;
+		std::atomic<NodeCount> nodes = 0;
+		std::exception_ptr error;
+		std::mutex error_mutex;
+
+		pool.parallel_for(run.partitions, [&](size_t p, unsigned thread) {
+			try {
+				std::vector<FrontierEntry> entries = take_merged(run, *current->partitions[p]);
+				unique += entries.size();
+				if (!last) {
+					expand(run, entries, *next, positions[thread]);
+					return;
+				}
+				NodeCount sum = 0;
+				for (const FrontierEntry& e : entries) {
+					unpack_position(e.pos, positions[thread]);
+					sum += e.paths * count_root(positions[thread], finish);
+				}
+				nodes += sum;
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(error_mutex);
+				if (!error) error = std::current_exception();
+			}
+		});
+		if (error) std::rethrow_exception(error);
+
+		auto end = std::chrono::steady_clock::now();
+		result.levels.push_back({ply, current->positions, unique, current->spilled_bytes,
+								 std::chrono::duration<double>(end - start).count()});
+		result.nodes = nodes;
+		current = std::move(next);
+	}
+	for (unsigned t = 0; counters && t < counters->size(); t++) result.thread_counters.push_back(counters->of(t));
+	return result;
+}
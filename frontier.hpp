@@ -0,0 +1,59 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "packed_position.hpp"
+#include "perf_counter.hpp"
+#include "position.hpp"
+#include "topology.hpp"
+
+#ifndef FRONTIER_H
+#define FRONTIER_H
+
+// Level synchronous perft. The tree is expanded one ply at a time into a frontier of unique positions, each with the
+// number of move paths that reach it, and only the last plies are counted depth first with count_root. Transpositions
+// are merged at every level, so each unique position is expanded and counted once.
+//
+// The frontier is split into hash partitions. A position always lands in the same partition, so partitions are
+// deduplicated independently: by sorting, in parallel over the threads. When the entries held in memory exceed the
+// budget, partitions are appended to files in the spill directory and read back when their level is processed.
+
+struct FrontierEntry {
+	PackedPosition pos;
+	uint64_t paths;
+};
+
+struct FrontierConfig {
+	unsigned threads = 1;
+	PinPolicy pin = PinPolicy::NONE;
+	// Count hardware events per thread.
+	bool counters = false;
+	// Plies counted by count_root below the last frontier level.
+	int finish_depth = 2;
+	unsigned partitions = 64;
+	size_t memory_budget = size_t(1) << 30;
+	std::string spill_dir;
+};
+
+struct FrontierLevel {
+	int ply;
+	uint64_t positions;
+	uint64_t unique;
+	uint64_t spilled_bytes;
+	double seconds;
+};
+
+struct FrontierResult {
+	NodeCount nodes = 0;
+	std::vector<FrontierLevel> levels;
+	// Placement::describe() of the threads that ran it.
+	std::string placement;
+	// Hardware counters by thread id, with FrontierConfig::counters.
+	std::vector<CounterValues> thread_counters;
+};
+
+// Counts the leaves at the given depth below pos. Throws std::runtime_error if a spill file can not be written.
+FrontierResult frontier_perft(Position& pos, int depth, const FrontierConfig& config = FrontierConfig());
+
+#endif
@@ -0,0 +1,140 @@
+#include <sys/mman.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+
+#ifndef HUGE_PAGES_H
+#define HUGE_PAGES_H
+
+// Memory on 2 MB pages, so large tables need few TLB entries. Explicit huge pages (MAP_HUGETLB) are used when the
+// system has some reserved, then transparent huge pages on a 2 MB aligned range (madvise(MADV_HUGEPAGE)), and normal
+// pages otherwise. Setting PYKE_HUGE_PAGES=0 forces normal pages, to compare both.
+
+inline constexpr size_t huge_page_size = size_t(2) << 20;
+
+enum class PageBacking : uint8_t { HUGETLB, TRANSPARENT, NORMAL };
+
+inline const char* backing_name(PageBacking backing) {
+	switch (backing) {
+	case PageBacking::HUGETLB:
+		return "hugetlb";
+	case PageBacking::TRANSPARENT:
+		return "transparent huge pages";
+	default:
+		return "normal pages";
+	}
+}
+
+inline bool huge_pages_enabled() {
+	static const bool enabled = [] {
+		const char* env = std::getenv("PYKE_HUGE_PAGES");
+		return !env || std::strcmp(env, "0");
+	}();
+	return enabled;
+}
+
+inline constexpr size_t round_to_huge_pages(size_t bytes) {
+	return (bytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+}
+
+// Maps round_to_huge_pages(bytes) of zeroed memory. Throws std::bad_alloc if nothing can be mapped.
+inline void* huge_alloc(size_t bytes, PageBacking* backing = nullptr) {
+	size_t size = round_to_huge_pages(bytes);
+	auto report = [&](PageBacking b) {
+		if (backing) *backing = b;
+	};
+	int prot = PROT_READ | PROT_WRITE;
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+	if (huge_pages_enabled()) {
+		void* p = mmap(nullptr, size, prot, flags | MAP_HUGETLB, -1, 0);
+		if (p != MAP_FAILED) {
+			report(PageBacking::HUGETLB);
+			return p;
+		}
+	}
+
+	// Over map by a page to cut out an aligned range, as huge pages only back aligned 2 MB ranges.
+	char* raw = static_cast<char*>(mmap(nullptr, size + huge_page_size, prot, flags, -1, 0));
+	if (raw == MAP_FAILED) throw std::bad_alloc();
+	char* p = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(raw) + huge_page_size - 1) & ~(huge_page_size - 1));
+	if (p > raw) munmap(raw, p - raw);
+	munmap(p + size, raw + huge_page_size - p);
+
+	bool advised = huge_pages_enabled() && madvise(p, size, MADV_HUGEPAGE) == 0;
+	report(advised ? PageBacking::TRANSPARENT : PageBacking::NORMAL);
+	return p;
+}
+
+// Advises the huge page aligned part of an untouched static range for transparent huge pages.
+inline PageBacking advise_huge_pages(void* p, size_t bytes) {
+	uintptr_t start = (reinterpret_cast<uintptr_t>(p) + huge_page_size - 1) & ~(huge_page_size - 1);
+	uintptr_t end = (reinterpret_cast<uintptr_t>(p) + bytes) & ~(huge_page_size - 1);
+	if (!huge_pages_enabled() || start >= end) return PageBacking::NORMAL;
+	return madvise(reinterpret_cast<void*>(start), end - start, MADV_HUGEPAGE) ? PageBacking::NORMAL
+																				 : PageBacking::TRANSPARENT;
+}
+
+inline void huge_free(void* p, size_t bytes) {
+	if (p) munmap(p, round_to_huge_pages(bytes));
+}
+
+// Bytes of the mapping holding p that the kernel currently backs with transparent huge pages, from /proc/self/smaps.
+// Returns 0 if it can not be read.
+inline size_t huge_backed_bytes(const void* p) {
+	std::ifstream smaps("/proc/self/smaps");
+	std::string line;
+	uintptr_t addr = reinterpret_cast<uintptr_t>(p);
+	bool inside = false;
+	while (std::getline(smaps, line)) {
+		uintptr_t start, end;
+		char dash;
+		std::istringstream range(line);
+		if (range >> std::hex >> start >> dash >> end && dash == '-') {
+			inside = start <= addr && addr < end;
+		} else if (inside && line.rfind("AnonHugePages:", 0) == 0) {
+			size_t kb = 0;
+			std::istringstream(line.substr(14)) >> kb;
+			return kb * 1024;
+		}
+	}
+	return 0;
+}
+
+// Allocator for large vectors. Allocations of at least a huge page are mapped with huge_alloc, smaller ones use new.
+template <typename T>
+struct HugePageAllocator {
+	using value_type = T;
+
+	HugePageAllocator() = default;
+	template <typename U>
+	HugePageAllocator(const HugePageAllocator<U>&) {}
+
+	T* allocate(size_t n) {
+		size_t bytes = n * sizeof(T);
+		if (bytes < huge_page_size) return std::allocator<T>().allocate(n);
+		return static_cast<T*>(huge_alloc(bytes));
+	}
+
+	void deallocate(T* p, size_t n) {
+		size_t bytes = n * sizeof(T);
+		if (bytes < huge_page_size)
+			std::allocator<T>().deallocate(p, n);
+		else
+			huge_free(p, bytes);
+	}
+
+	template <typename U>
+	bool operator==(const HugePageAllocator<U>&) const {
+		return true;
+	}
+};
+
+#endif
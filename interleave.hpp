@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "movegen.hpp"
+#include "perft.hpp"
+#include "perft_progress.hpp"
+
+#ifndef INTERLEAVE_H
+#define INTERLEAVE_H
+
+// Perft that walks several subtrees at once on one thread, to overlap the cache misses of their attack table lookups.
+// Each lane walks its subtree depth first with an explicit stack and stops at every position finish_depth plies above
+// the leaves. There it prefetches the slider table entries the count will read, and the other lanes take a turn
+// before it is counted with count_root. Lanes take the subtrees below the split ply as they finish their last one.
+
+// Depth first walk of one subtree that can be suspended at each position of its frontier.
+struct SubtreeWalk {
+	Position pos;
+	int depth = 0;
+	int finish = 1;
+
+	void start(const Position& root, const MovePath& path, int total_depth, int finish_depth) {
+		pos = root;
+		for (const Move& m : path) pyke::make_move(pos, m);
+		depth = total_depth - int(path.size());
+		finish = finish_depth;
+		levels = 0;
+		made = 0;
+		started = false;
+	}
+
+	// Moves to the next frontier position. Returns false when the subtree is done.
+	bool advance() {
+		if (!started) {
+			started = true;
+			if (depth <= finish) return true;
+			push_level();
+		} else if (depth <= finish) {
+			return false;
+		} else {
+			unmake_top();
+		}
+		for (;;) {
+			int top = levels - 1;
+			if (next[top] < moves[top].size()) {
+				Move m = moves[top][next[top]++];
+				undo[made] = pyke::make_move(pos, m);
+				made++;
+				if (made == depth - finish) return true;
+				push_level();
+			} else if (--levels == 0) {
+				return false;
+			} else {
+				unmake_top();
+			}
+		}
+	}
+
+private:
+	// Depth 10 is the deepest count_root handles.
+	static constexpr int max_levels = 10;
+	MoveBuffer moves[max_levels];
+	int next[max_levels];
+	MoveUndo undo[max_levels];
+	int levels = 0;
+	int made = 0;
+	bool started = false;
+
+	void push_level() {
+		pyke::generate_legal_moves(pos, moves[levels]);
+		next[levels++] = 0;
+	}
+
+	void unmake_top() {
+		made--;
+		pyke::unmake_move(pos, moves[made][next[made] - 1], undo[made]);
+	}
+};
+
+// Prefetches the slider table entries the count of pos starts with: the pin and check rays of create_masks, the reach
+// of the own sliders and the attack probes of the king steps.
+template <bool white>
+static inline void prefetch_node(Position& pos) {
+	Board& b = pos.board;
+	Square ksq = pos.get_ksq<white>();
+	BitBoard occ = b.occ_board;
+	BitBoard opp = b.get_player_occ<!white>();
+	prefetch_bishop_move(ksq, opp);
+	prefetch_rook_move(ksq, opp);
+
+	BitBoard diag = b.get_piece_board<white, BISHOP>() | b.get_piece_board<white, QUEEN>();
+	BitBoard orth = b.get_piece_board<white, ROOK>() | b.get_piece_board<white, QUEEN>();
+	while (diag) prefetch_bishop_move(pop(diag), occ);
+	while (orth) prefetch_rook_move(pop(orth), occ);
+
+	BitBoard steps = get_king_move(ksq) & ~b.get_player_occ<white>();
+	BitBoard lifted = occ & ~square_to_mask(ksq);
+	while (steps) {
+		Square to = pop(steps);
+		prefetch_bishop_move(to, lifted | square_to_mask(to));
+		prefetch_rook_move(to, lifted | square_to_mask(to));
+	}
+}
+
+static inline void prefetch_node(Position& pos) {
+	if (pos.white_turn)
+		prefetch_node<true>(pos);
+	else
+		prefetch_node<false>(pos);
+}
+
+struct InterleaveConfig {
+	// Subtrees walked at once. One lane is a plain depth first walk through the same code.
+	int lanes = 4;
+	// Plies counted by count_root below each frontier position.
+	int finish_depth = 2;
+	int split_ply = 2;
+};
+
+// Leaves at depth below pos. Restores pos.
+static NodeCount interleaved_perft(Position& pos, int depth, const InterleaveConfig& config = InterleaveConfig()) {
+	if (depth <= 0) return 1;
+	int finish = std::clamp(config.finish_depth, 1, depth);
+	std::vector<MovePath> units = perft_paths(pos, std::clamp(config.split_ply, 0, depth - finish));
+	std::vector<SubtreeWalk> walks(std::max(config.lanes, 1));
+	std::vector<bool> active(walks.size());
+	size_t next_unit = 0;
+	NodeCount nodes = 0;
+
+	// Moves a lane to its next frontier position, taking a new subtree when its own is done, and prefetches for it.
+	auto step = [&](size_t lane) {
+		SubtreeWalk& w = walks[lane];
+		while (!(active[lane] && w.advance())) {
+			if (next_unit == units.size()) {
+				active[lane] = false;
+				return;
+			}
+			w.start(pos, units[next_unit++], depth, finish);
+			active[lane] = true;
+		}
+		prefetch_node(w.pos);
+	};
+
+	for (size_t lane = 0; lane < walks.size(); lane++) step(lane);
+	for (bool any = true; any;) {
+		any = false;
+		for (size_t lane = 0; lane < walks.size(); lane++) {
+			if (!active[lane]) continue;
+			any = true;
+			nodes += count_root(walks[lane].pos, finish);
+			step(lane);
+		}
+	}
+	return nodes;
+}
+
+#endif
@@ -0,0 +1,84 @@
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "interleave.hpp"
+#include "perft.hpp"
+
+// MNPS of interleaved_perft over lane counts and finish depths against count_root, on the perft suite. Every count
+// is checked against count_root.
+
+struct SuitePosition {
+	std::string fen;
+	int depth;
+};
+
+const std::vector<SuitePosition> suite = {
+	{"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 6},
+	{"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5},
+	{"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 7},
+	{"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 5},
+	{"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 5},
+	{"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 5},
+};
+
+static double seconds_of(const std::function<void()>& f) {
+	auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+	std::vector<int> lane_counts = {1, 2, 4, 8};
+	std::vector<int> finish_depths = {1, 2, 3};
+	int depth_offset = 0;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--lanes" && i + 1 < argc) {
+			lane_counts = {std::stoi(argv[++i])};
+		} else if (arg == "--finish" && i + 1 < argc) {
+			finish_depths = {std::stoi(argv[++i])};
+		} else if (arg == "--deeper" && i + 1 < argc) {
+			depth_offset = std::stoi(argv[++i]);
+		} else {
+			std::cout << "Usage: interleave_bench [--lanes N] [--finish DEPTH] [--deeper PLIES]\n";
+			return 1;
+		}
+	}
+
+	std::vector<Position> positions(suite.size());
+	NodeCount expected = 0;
+	double s = seconds_of([&] {
+		for (size_t i = 0; i < suite.size(); i++) {
+			positions[i].load_fen(suite[i].fen);
+			expected += count_root(positions[i], suite[i].depth + depth_offset);
+		}
+	});
+	std::cout << std::left << std::setw(28) << "method" << std::right << std::setw(12) << "MNPS" << '\n';
+	std::cout << std::left << std::setw(28) << "count_root" << std::right << std::setw(12) << std::fixed
+			  << std::setprecision(1) << expected / s / 1e6 << '\n';
+
+	int failures = 0;
+	for (int finish : finish_depths) {
+		for (int lanes : lane_counts) {
+			InterleaveConfig config;
+			config.lanes = lanes;
+			config.finish_depth = finish;
+			NodeCount nodes = 0;
+			s = seconds_of([&] {
+				for (size_t i = 0; i < suite.size(); i++)
+					nodes += interleaved_perft(positions[i], suite[i].depth + depth_offset, config);
+			});
+			bool ok = nodes == expected;
+			failures += !ok;
+			std::string name = "interleaved " + std::to_string(lanes) + " lanes, finish " + std::to_string(finish);
+			std::cout << std::left << std::setw(28) << name << std::right << std::setw(12) << nodes / s / 1e6
+					  << (ok ? "" : "  MISMATCH") << '\n';
+		}
+	}
+	return failures ? 1 : 0;
+}
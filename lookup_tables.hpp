@@ -6,6 +6,7 @@
 #include <cstdlib>
 
 #include "defaults.hpp"
+#include "huge_pages.hpp"
 #include "util.hpp"
 
 #ifndef LOOKUPTABLES_H
@@ -465,6 +466,16 @@ constexpr std::array<std::array<uint64_t, 64>, 2> make_pawn_edge_masks() {
 
 static const std::array<std::array<uint64_t, 64>, 2> pawn_edge_masks = make_pawn_edge_masks();
 
+constexpr std::array<BitBoard, 64> make_lines(uint64_t (*attack_on_fly)(uint8_t, uint64_t)) {
+	std::array<BitBoard, 64> ret = {};
+	for (int s = 0; s < 64; s++) ret[s] = attack_on_fly(s, 0);
+	return ret;
+}
+
+// Empty board slider reach: the lines through a king that pins and slider checks run along.
+static constexpr std::array<BitBoard, 64> diag_lines = make_lines(bishop_attack_on_fly);
+static constexpr std::array<BitBoard, 64> orth_lines = make_lines(rook_attack_on_fly);
+
 // PEXT
 
 static constexpr uint32_t rook_pext_size = 102400;
@@ -500,43 +511,44 @@ static std::array<BitBoard, 64> init_bishop_pext_offset() {
 
 static const std::array<BitBoard, 64> bishop_pext_offset = init_bishop_pext_offset();
 
-// Bishop attacks.
-static std::array<BitBoard, bishop_pext_size> init_bishop_pext_atk() {
-	std::array<BitBoard, bishop_pext_size> ret{};
-	uint32_t offset = 0;
-	for (Square s = 0; s < 64; ++s) {
-		uint32_t mask_bits = popcnt(bishop_mask_table[s]);
-		uint32_t perm_amount = 1 << mask_bits;
-
-		for (uint32_t perm = 0; perm < perm_amount; ++perm) {
-			BitBoard blocker = _pdep_u64(static_cast<uint64_t>(perm), bishop_mask_table[s]);
-			ret[offset + perm] = bishop_attack_on_fly(s, blocker);
-		}
-		offset += perm_amount;
-	}
+// Slider attack tables and between_squares, in one block aligned to a huge page and shared by all translation units.
+// The block is zero initialized storage that is first touched when the tables are filled at startup, so advising it
+// for transparent huge pages beforehand puts the whole slider working set on one 2 MB page, while the tables keep
+// their link time addresses.
+struct alignas(huge_page_size) LookupTables {
+	BitBoard rook_pext_atk[rook_pext_size];
+	BitBoard bishop_pext_atk[bishop_pext_size];
+	std::array<uint64_t, 64> between_squares[64];
+};
 
-	return ret;
-}
-static const std::array<BitBoard, bishop_pext_size> bishop_pext_atk = init_bishop_pext_atk();
+inline LookupTables lookup_tables;
+inline PageBacking lookup_tables_backing = PageBacking::NORMAL;
+// Tables the slider lookups of this thread read. Threads of a pinned ThreadPool switch to the replica on their NUMA
+// node (topology.hpp). Initial exec, so the shared library reads it without a call to __tls_get_addr.
+inline thread_local const LookupTables* thread_lookup_tables __attribute__((tls_model("initial-exec"))) =
+	&lookup_tables;
 
-// Rook attacks.
-static std::array<BitBoard, rook_pext_size> init_rook_pext_atk() {
-	std::array<BitBoard, rook_pext_size> ret{};
+static void init_pext_atk(BitBoard* table, const BitBoard* masks, BitBoard (*attack_on_fly)(Square, BitBoard)) {
 	uint32_t offset = 0;
 	for (Square s = 0; s < 64; ++s) {
-		uint32_t mask_bits = popcnt(rook_mask_table[s]);
+		uint32_t mask_bits = popcnt(masks[s]);
 		uint32_t perm_amount = 1 << mask_bits;
 
 		for (uint32_t perm = 0; perm < perm_amount; ++perm) {
-			BitBoard blocker = _pdep_u64(static_cast<uint64_t>(perm), rook_mask_table[s]);
-			ret[offset + perm] = rook_attack_on_fly(s, blocker);
+			BitBoard blocker = _pdep_u64(static_cast<uint64_t>(perm), masks[s]);
+			table[offset + perm] = attack_on_fly(s, blocker);
 		}
 		offset += perm_amount;
 	}
-
-	return ret;
 }
-static const std::array<BitBoard, rook_pext_size> rook_pext_atk = init_rook_pext_atk();
+
+// Bishop and rook attacks.
+inline const bool pext_atk_filled = [] {
+	lookup_tables_backing = advise_huge_pages(&lookup_tables, sizeof(lookup_tables));
+	init_pext_atk(lookup_tables.bishop_pext_atk, bishop_mask_table.data(), bishop_attack_on_fly);
+	init_pext_atk(lookup_tables.rook_pext_atk, rook_mask_table.data(), rook_attack_on_fly);
+	return true;
+}();
 
 // En pessant squares.
 static constexpr inline std::pair<Square, Square> ep_sqs_wl[8] =
@@ -108,24 +108,6 @@ static void unmake_ep_move(Board& b, BitBoard move, BitBoard capture_sq) {
 	add_to_board<!white, PAWN>(b, capture_sq);
 }
 
-// Do promo move.
-template <bool white, Piece p, Piece captured>
-static void promo_move(Square from, Square to, Position& pos) {
-	// Check if promotion was also a capture.
-	if constexpr (captured != EMPTY) remove_from_board<white, captured>(pos.board, to);
-	remove_from_board<white, PAWN>(pos.board, from);
-	add_to_board<white, p>(pos.board, to);
-}
-
-// Undo promo move.
-template <bool white, Piece p, Piece captured>
-static void unmake_promo_move(Square from, Square to, Position& pos) {
-	add_to_board<white, PAWN>(pos.board, from, PAWN);
-	remove_from_board<white, p>(pos.board, to);
-	// Check if promotion was also a capture.
-	if constexpr (captured != EMPTY) add_to_board<white, captured>(pos.board, to);
-}
-
 // Do pawn double forward move.
 template <bool white>
 static bool pawn_double(Board& b, BitBoard move, BitBoard to, uint8_t& ep_flag) {
@@ -200,6 +182,28 @@ static void unmake_capture_wrapper(Board& b, Piece captured, BitBoard move, BitB
 	}
 }
 
+// Do promo move. The pawn is moved, capturing if needed, and then swapped for the promotion piece.
+template <bool white, Piece p>
+static void promo_move(Board& b, Piece captured, BitBoard move, BitBoard to) {
+	if (captured == EMPTY)
+		plain_move<white, PAWN>(b, move);
+	else
+		capture_move_wrapper<white, PAWN>(b, captured, move, to);
+	*b.get_board_pointer<white, PAWN>() ^= to;
+	*b.get_board_pointer<white, p>() ^= to;
+}
+
+// Undo promo move.
+template <bool white, Piece p>
+static void unmake_promo_move(Board& b, Piece captured, BitBoard move, BitBoard to) {
+	*b.get_board_pointer<white, p>() ^= to;
+	*b.get_board_pointer<white, PAWN>() ^= to;
+	if (captured == EMPTY)
+		unmake_plain_move<white, PAWN>(b, move);
+	else
+		unmake_capture_wrapper<white, PAWN>(b, captured, move, to);
+}
+
 // Add piece to board.
 static void add_to_board(Board& b, Square s, Piece p, bool white) {
 	BitBoard mask = square_to_mask(s);
@@ -1,12 +1,22 @@
 #include <cstdint>
+#include <stdexcept>
 
 #include "board.hpp"
 #include "defaults.hpp"
+#include "material.hpp"
 #include "piece_moves.hpp"
 
 #ifndef MASKSET_H
 #define MASKSET_H
 
+// Whether count_moves carries the pins over from parent to child nodes (create_masks_after) instead of recomputing
+// them, set with the PYKE_INCREMENTAL_MASKS build option.
+#ifdef PYKE_INCREMENTAL_MASKS
+inline constexpr bool incremental_masks = true;
+#else
+inline constexpr bool incremental_masks = false;
+#endif
+
 struct MaskSet {
 	// squares that are empty or enemy;
 	BitBoard cmt;
@@ -19,6 +29,14 @@ struct MaskSet {
 
 	uint8_t checkers = 0;
 
+	// Set by the parent node for all of its children: the pins of the side to move in the parent's position, and the
+	// occupancy of both sides they were found on.
+	bool lines_valid = false;
+	BitBoard line_pins_dg = 0;
+	BitBoard line_pins_orth = 0;
+	BitBoard line_own = 0;
+	BitBoard line_opp = 0;
+
 	inline uint8_t get_check_cnt() { return checkers; }
 
 	inline void reset() {
@@ -29,21 +47,13 @@ struct MaskSet {
 	}
 };
 
-// Create all the needed masks for the current position.
-template <bool white>
-MaskSet& create_masks(Board& b, Square king_square, MaskSet& ret) {
-	ret.reset();
-	ret.cmt = ~b.get_player_occ<white>();
-
-	BitBoard opp_board = b.get_player_occ<!white>();
-	BitBoard own_board = b.get_player_occ<white>();
-	BitBoard eq = b.get_piece_board<!white, QUEEN>();
-	BitBoard eb = b.get_piece_board<!white, BISHOP>();
-	BitBoard er = b.get_piece_board<!white, ROOK>();
-	BitBoard diag_pinners = get_bishop_move(king_square, opp_board) & (eb | eq);
-	BitBoard orth_pinners = get_rook_move(king_square, opp_board) & (er | eq);
+// Checks by an enemy knight or pawn.
+template <bool white, MaterialMask mat>
+static inline void add_leaper_checks(Board& b, Square king_square, MaskSet& ret) {
 	BitBoard k_checkers = get_knight_move(king_square) & b.get_piece_board<!white, KNIGHT>();
-	BitBoard p_checkers = get_pawn_diags<white>(square_to_mask(king_square)) & b.get_piece_board<!white, PAWN>();
+	BitBoard p_checkers = 0;
+	if constexpr (has_pawns(mat))
+		p_checkers = get_pawn_attacks<white>(square_to_mask(king_square)) & b.get_piece_board<!white, PAWN>();
 
 	if (k_checkers) {
 		ret.check_mask |= k_checkers;
@@ -52,29 +62,100 @@ MaskSet& create_masks(Board& b, Square king_square, MaskSet& ret) {
 		ret.check_mask |= p_checkers;
 		ret.checkers++;
 	}
+}
 
-	auto process_pinners = [&](BitBoard& pinboard, BitBoard& goal_mask) {
-		while (pinboard) {
-			Square src = pop(pinboard);
-			BitBoard between = between_squares[king_square][src];
-
-			switch (popcnt(between & own_board)) {
-			case 0:
-				ret.check_mask |= between;
-				ret.checkers++;
-				break;
-			case 1:
-				goal_mask |= between;
-				break;
-			}
+// Pins and checks by the enemy sliders along the diagonal or the orthogonal lines through the king.
+template <bool white, bool diag>
+static inline void add_slider_lines(Board& b, Square king_square, MaskSet& ret) {
+	BitBoard own_board = b.get_player_occ<white>();
+	BitBoard opp_board = b.get_player_occ<!white>();
+	BitBoard eq = b.get_piece_board<!white, QUEEN>();
+	BitBoard pinners = diag ? get_bishop_move(king_square, opp_board) & (b.get_piece_board<!white, BISHOP>() | eq)
+							: get_rook_move(king_square, opp_board) & (b.get_piece_board<!white, ROOK>() | eq);
+	BitBoard& goal_mask = diag ? ret.pinmask_dg : ret.pinmask_orth;
+
+	while (pinners) {
+		Square src = pop(pinners);
+		BitBoard between = between_squares[king_square][src];
+
+		switch (popcnt(between & own_board)) {
+		case 0:
+			ret.check_mask |= between;
+			ret.checkers++;
+			break;
+		case 1:
+			goal_mask |= between;
+			break;
 		}
-	};
+	}
+}
 
-	process_pinners(diag_pinners, ret.pinmask_dg);
-	process_pinners(orth_pinners, ret.pinmask_orth);
+// Create all the needed masks for the current position. Checks and pins by piece kinds the signature rules out are
+// not looked for.
+template <bool white, MaterialMask mat = all_material>
+MaskSet& create_masks(Board& b, Square king_square, MaskSet& ret) {
+	ret.reset();
+	ret.cmt = ~b.get_player_occ<white>();
+	add_leaper_checks<white, mat>(b, king_square, ret);
+	if constexpr (has_sliders<!white>(mat)) {
+		add_slider_lines<white, true>(b, king_square, ret);
+		add_slider_lines<white, false>(b, king_square, ret);
+	}
 	ret.nopin = ~(ret.pinmask_dg | ret.pinmask_orth);
 
 	return ret;
 }
 
+// Stores the pins of the side not to move, whose king is on king_square, in next, the mask slot of the children. That
+// side can not be in check, so there are only pins to find.
+template <bool white, MaterialMask mat = all_material>
+void prepare_child_masks(Board& b, Square king_square, MaskSet& next) {
+	MaskSet lines;
+	if constexpr (has_sliders<white>(mat)) {
+		add_slider_lines<!white, true>(b, king_square, lines);
+		add_slider_lines<!white, false>(b, king_square, lines);
+	}
+	next.lines_valid = true;
+	next.line_pins_dg = lines.pinmask_dg;
+	next.line_pins_orth = lines.pinmask_orth;
+	next.line_own = b.get_player_occ<!white>();
+	next.line_opp = b.get_player_occ<white>();
+}
+
+// create_masks in a child of a node that called prepare_child_masks. The squares the move changed are where the
+// occupancy of either side differs from the parent's. A slider can only start to check or pin, or stop pinning, along
+// a line through the king that holds a changed square, so the pins along the diagonal or the orthogonal lines are
+// taken over from the parent when none of their squares changed. Likewise a knight or pawn can only give check from a
+// changed square. Built with PYKE_CHECK_MASKS, every result is compared to create_masks.
+template <bool white, MaterialMask mat = all_material>
+MaskSet& create_masks_after(Board& b, Square king_square, MaskSet& ret) {
+	if (!ret.lines_valid) return create_masks<white, mat>(b, king_square, ret);
+	BitBoard changed = (b.get_player_occ<white>() ^ ret.line_own) | (b.get_player_occ<!white>() ^ ret.line_opp);
+
+	ret.reset();
+	ret.cmt = ~b.get_player_occ<white>();
+	if (changed & (get_knight_move(king_square) | get_pawn_attacks<white>(square_to_mask(king_square))))
+		add_leaper_checks<white, mat>(b, king_square, ret);
+	if constexpr (has_sliders<!white>(mat)) {
+		if (changed & diag_lines[king_square])
+			add_slider_lines<white, true>(b, king_square, ret);
+		else
+			ret.pinmask_dg = ret.line_pins_dg;
+		if (changed & orth_lines[king_square])
+			add_slider_lines<white, false>(b, king_square, ret);
+		else
+			ret.pinmask_orth = ret.line_pins_orth;
+	}
+	ret.nopin = ~(ret.pinmask_dg | ret.pinmask_orth);
+
+#ifdef PYKE_CHECK_MASKS
+	MaskSet full;
+	create_masks<white, mat>(b, king_square, full);
+	if (full.cmt != ret.cmt || full.pinmask_dg != ret.pinmask_dg || full.pinmask_orth != ret.pinmask_orth
+		|| full.check_mask != ret.check_mask || full.checkers != ret.checkers)
+		throw std::logic_error("create_masks_after differs from create_masks");
+#endif
+	return ret;
+}
+
 #endif
@@ -0,0 +1,247 @@
+#include <cstdint>
+#include <vector>
+
+#include "maskset.hpp"
+#include "movegen.hpp"
+#include "playout.hpp"
+#include "position.hpp"
+#include "thread_pool.hpp"
+
+#ifndef MATE_H
+#define MATE_H
+
+struct MateProblem {
+	Position pos;
+	// Claimed number of attacker moves.
+	int moves;
+};
+
+struct MateResult {
+	bool proved = false;
+	// Shortest mate found, up to the claim, and its first move.
+	int shortest = 0;
+	Move first;
+	uint64_t nodes = 0;
+};
+
+namespace pyke {
+
+// Own pieces that are the only blocker between one of our sliders and the enemy king, with the line they block.
+struct Discoverers {
+	BitBoard squares = 0;
+	Square from[8];
+	BitBoard line[8];
+	int count = 0;
+
+	// Squares a discoverer on from can move to without uncovering the check, or all squares for other pieces.
+	inline BitBoard keep(Square from_sq) const {
+		if (!(squares & square_to_mask(from_sq))) return ~0ULL;
+		for (int i = 0; i < count; i++) {
+			if (from[i] == from_sq) return line[i];
+		}
+		return ~0ULL;
+	}
+};
+
+template <bool white>
+static inline void find_discoverers(Board& b, Square eksq, Discoverers& out) {
+	BitBoard own = b.get_player_occ<white>();
+	BitBoard queens = b.get_piece_board<white, QUEEN>();
+	BitBoard sliders = (get_bishop_move(eksq, 0) & (b.get_piece_board<white, BISHOP>() | queens))
+		| (get_rook_move(eksq, 0) & (b.get_piece_board<white, ROOK>() | queens));
+	while (sliders) {
+		Square s = pop(sliders);
+		BitBoard line = between_squares[eksq][s] & ~square_to_mask(s);
+		BitBoard blockers = line & b.occ_board;
+		if (popcnt(blockers) != 1 || !(blockers & own)) continue;
+		out.squares |= blockers;
+		out.from[out.count] = lbit(blockers);
+		out.line[out.count++] = line;
+	}
+}
+
+// Whether the move checks the enemy king, by making it. Used for the rare castling and ep moves.
+template <bool white>
+static inline bool gives_check(Position& pos, Move m) {
+	MoveUndo undo = make_move<white>(pos, m);
+	bool check = pos.is_attacked<!white>(pos.get_ksq<!white>());
+	unmake_move<white>(pos, m, undo);
+	return check;
+}
+
+// Fills out with the legal moves that give check. The legal target sets come from collect_choices, so they carry the
+// same check and pin masks as the full generator. Each one is then cut down to the squares from which the piece
+// attacks the enemy king, plus every square off the blocked line for discovered check candidates.
+template <bool white>
+void generate_checks(Position& pos, MoveBuffer& out) {
+	out.clear();
+	Board& b = pos.board;
+	Square eksq = pos.get_ksq<!white>();
+	MoveChoices choices;
+	collect_choices<white>(pos, choices);
+	if (!choices.total) return;
+
+	Discoverers disc;
+	find_discoverers<white>(b, eksq, disc);
+	BitBoard occ = b.occ_board;
+	BitBoard king_mask = square_to_mask(eksq);
+
+	for (int i = 0; i < choices.count; i++) {
+		const TargetGroup& g = choices.groups[i];
+		BitBoard from_mask = square_to_mask(g.from);
+		BitBoard discovered = ~disc.keep(g.from);
+		BitBoard targets = g.targets;
+
+		switch (g.type) {
+		case MOVE_CASTLE:
+		case MOVE_EP: {
+			Move m = g.type == MOVE_CASTLE ? Move(MOVE_CASTLE, KING, g.from, lbit(targets))
+										   : Move(MOVE_EP, PAWN, g.from, lbit(targets), PAWN);
+			if (gives_check<white>(pos, m)) out.push(m);
+			continue;
+		}
+		case MOVE_PROMOTION:
+			while (targets) {
+				Square to = pop(targets);
+				BitBoard after = (occ & ~from_mask) | square_to_mask(to);
+				Piece captured = b.get_piece<!white>(to);
+				bool disc_check = discovered & square_to_mask(to);
+				for (Piece p : promotion_pieces) {
+					BitBoard attacks = p == KNIGHT ? get_knight_move(to)
+						: p == BISHOP			   ? get_bishop_move(to, after)
+						: p == ROOK				   ? get_rook_move(to, after)
+												   : get_queen_move(to, after);
+					if (disc_check || (attacks & king_mask)) out.push(Move(MOVE_PROMOTION, PAWN, g.from, to, captured, p));
+				}
+			}
+			continue;
+		default:
+			break;
+		}
+
+		// Sliders look through their own square, as they may move away from the king along the checking line.
+		BitBoard direct;
+		switch (g.piece) {
+		case KNIGHT:
+			direct = get_knight_move(eksq);
+			break;
+		case BISHOP:
+			direct = get_bishop_move(eksq, occ & ~from_mask);
+			break;
+		case ROOK:
+			direct = get_rook_move(eksq, occ & ~from_mask);
+			break;
+		case QUEEN:
+			direct = get_queen_move(eksq, occ & ~from_mask);
+			break;
+		case PAWN:
+			direct = get_pawn_attacks<!white>(king_mask);
+			break;
+		default:
+			direct = 0;
+		}
+
+		targets &= direct | discovered;
+		while (targets) {
+			Square to = pop(targets);
+			MoveType type = g.piece == PAWN && (to == g.from + 16 || g.from == to + 16) ? MOVE_DOUBLE : MOVE_NORMAL;
+			out.push(Move(type, g.piece, g.from, to, b.get_piece<!white>(to)));
+		}
+	}
+}
+
+inline void generate_checks(Position& pos, MoveBuffer& out) {
+	if (pos.white_turn)
+		generate_checks<true>(pos, out);
+	else
+		generate_checks<false>(pos, out);
+}
+
+static inline bool side_in_check(Position& pos) {
+	return pos.white_turn ? pos.is_attacked<true>(pos.wksq) : pos.is_attacked<false>(pos.bksq);
+}
+
+// Proves mates of the side to move. The last attacker move must give mate, so only checks are generated there.
+// Earlier attacker plies try checks first and then the quiet moves, unless checks_only restricts the search to mates
+// where every attacker move checks. Defender plies search every evasion and stop at the first one that escapes.
+struct MateSolver {
+	bool checks_only = false;
+	uint64_t nodes = 0;
+
+	// Whether the side to move mates in at most n moves. Sets first to the mating move at the root.
+	bool attacker_mates(Position& pos, int n, Move* first = nullptr) {
+		nodes++;
+		MoveBuffer moves;
+		generate_checks(pos, moves);
+		for (Move m : moves) {
+			MoveUndo undo = make_move(pos, m);
+			bool mates = defender_loses(pos, n);
+			unmake_move(pos, m, undo);
+			if (mates) {
+				if (first) *first = m;
+				return true;
+			}
+		}
+		if (n == 1 || checks_only) return false;
+
+		generate_legal_moves(pos, moves);
+		for (Move m : moves) {
+			MoveUndo undo = make_move(pos, m);
+			// Checks were tried above.
+			bool mates = !side_in_check(pos) && defender_loses(pos, n);
+			unmake_move(pos, m, undo);
+			if (mates) {
+				if (first) *first = m;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Whether the side to move is mated now or within n - 1 further attacker moves.
+	bool defender_loses(Position& pos, int n) {
+		nodes++;
+		if (n == 1) return count_choices(pos) == 0 && side_in_check(pos);
+
+		MoveBuffer replies;
+		generate_legal_moves(pos, replies);
+		if (!replies.size()) return side_in_check(pos);
+		for (Move r : replies) {
+			MoveUndo undo = make_move(pos, r);
+			bool mated = attacker_mates(pos, n - 1);
+			unmake_move(pos, r, undo);
+			if (!mated) return false;
+		}
+		return true;
+	}
+
+	// Finds the shortest mate up to the claimed length.
+	MateResult solve(Position pos, int moves) {
+		MateResult ret;
+		nodes = 0;
+		for (int n = 1; n <= moves && !ret.proved; n++) {
+			if (attacker_mates(pos, n, &ret.first)) {
+				ret.proved = true;
+				ret.shortest = n;
+			}
+		}
+		ret.nodes = nodes;
+		return ret;
+	}
+};
+
+// Solves every problem over the pool, one problem per task.
+inline std::vector<MateResult> solve_mates(const std::vector<MateProblem>& problems, ThreadPool& pool,
+										   bool checks_only = false) {
+	std::vector<MateResult> ret(problems.size());
+	pool.parallel_for(problems.size(), [&](size_t i, unsigned) {
+		MateSolver solver;
+		solver.checks_only = checks_only;
+		ret[i] = solver.solve(problems[i].pos, problems[i].moves);
+	});
+	return ret;
+}
+
+};	// namespace pyke
+
+#endif
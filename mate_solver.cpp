@@ -0,0 +1,101 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mate.hpp"
+
+// Checks "mate in N" claims. Input lines are "<fen>;<n>", read from --file or stdin; empty lines and lines starting
+// with '#' are skipped. Prints one line per claim with the shortest mate found and its first move, or "refuted".
+
+static void parse_claim(const std::string& line, MateProblem& out) {
+	size_t sep = line.rfind(';');
+	if (sep == std::string::npos) throw std::invalid_argument("Missing ';<moves>' in: " + line);
+	out.pos.load_fen(line.substr(0, sep));
+	out.moves = std::stoi(line.substr(sep + 1));
+	if (out.moves < 1) throw std::invalid_argument("Mate length must be positive in: " + line);
+}
+
+int main(int argc, char* argv[]) {
+	std::ios::sync_with_stdio(false);
+	std::string file, fen;
+	int moves = 0;
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	PinPolicy pin = PinPolicy::NONE;
+	bool checks_only = false;
+	bool quiet = false;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--file" && i + 1 < argc) {
+			file = argv[++i];
+		} else if (arg == "--fen" && i + 1 < argc) {
+			fen = argv[++i];
+		} else if (arg == "--mate" && i + 1 < argc) {
+			moves = std::stoi(argv[++i]);
+		} else if (arg == "--threads" && i + 1 < argc) {
+			threads = std::stoi(argv[++i]);
+		} else if (arg == "--pin" && i + 1 < argc) {
+			pin = parse_pin_policy(argv[++i]);
+		} else if (arg == "--checks-only") {
+			checks_only = true;
+		} else if (arg == "--quiet") {
+			quiet = true;
+		} else {
+			std::cout << "Usage: mate_solver [--file FILE | --fen FEN --mate N] [--threads N] [--pin POLICY] "
+						 "[--checks-only] [--quiet]\n";
+			return 1;
+		}
+	}
+
+	std::vector<MateProblem> problems;
+	std::vector<std::string> lines;
+	try {
+		if (!fen.empty()) {
+			lines.push_back(fen + ';' + std::to_string(moves));
+		} else {
+			std::ifstream in;
+			if (!file.empty()) {
+				in.open(file);
+				if (!in) throw std::invalid_argument("Can not open " + file);
+			}
+			std::istream& src = file.empty() ? std::cin : in;
+			std::string line;
+			while (std::getline(src, line)) {
+				if (!line.empty() && line[0] != '#') lines.push_back(line);
+			}
+		}
+		problems.resize(lines.size());
+		for (size_t i = 0; i < lines.size(); i++) parse_claim(lines[i], problems[i]);
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+
+	ThreadPool pool(threads, pin);
+	auto start = std::chrono::steady_clock::now();
+	std::vector<MateResult> results = pyke::solve_mates(problems, pool, checks_only);
+	double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	uint64_t proved = 0, shorter = 0, nodes = 0;
+	for (size_t i = 0; i < results.size(); i++) {
+		const MateResult& r = results[i];
+		proved += r.proved;
+		shorter += r.proved && r.shortest < problems[i].moves;
+		nodes += r.nodes;
+		if (quiet) continue;
+		std::cout << lines[i] << ": ";
+		if (r.proved)
+			std::cout << "mate in " << r.shortest << ", " << r.first.to_string() << '\n';
+		else
+			std::cout << "refuted\n";
+	}
+	std::cout << "Claims: " << results.size() << ", proved: " << proved << " (" << shorter
+			  << " shorter than claimed), refuted: " << results.size() - proved << '\n';
+	std::cout << "Time: " << s << " s, " << uint64_t(results.size() / s) << " claims/s, " << uint64_t(nodes / s)
+			  << " nodes/s\nThreads: " << pool.get_placement().describe() << std::endl;
+	return 0;
+}
@@ -0,0 +1,42 @@
+#include <cstdint>
+
+#include "board.hpp"
+#include "defaults.hpp"
+
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+// Piece kinds known to be off the board, so the generators and attack probes for them can be compiled out. A
+// signature only ever claims absence, so all_material, which claims nothing, is correct for every position.
+using MaterialMask = uint8_t;
+
+constexpr MaterialMask all_material = 0;
+constexpr MaterialMask no_white_sliders = 0b001;
+constexpr MaterialMask no_black_sliders = 0b010;
+constexpr MaterialMask no_pawns = 0b100;
+constexpr MaterialMask max_material = 0b111;
+
+template <bool white>
+constexpr inline MaterialMask no_sliders() {
+	return white ? no_white_sliders : no_black_sliders;
+}
+
+template <bool white>
+constexpr inline bool has_sliders(MaterialMask mat) {
+	return !(mat & no_sliders<white>());
+}
+
+constexpr inline bool has_pawns(MaterialMask mat) { return !(mat & no_pawns); }
+
+template <bool white>
+inline BitBoard slider_board(Board& b) {
+	return b.get_piece_board<white, ROOK>() | b.get_piece_board<white, BISHOP>() | b.get_piece_board<white, QUEEN>();
+}
+
+// Exact signature of a board.
+inline MaterialMask material_of(Board& b) {
+	return (slider_board<true>(b) ? 0 : no_white_sliders) | (slider_board<false>(b) ? 0 : no_black_sliders)
+		| (b.get_piece_board<true, PAWN>() | b.get_piece_board<false, PAWN>() ? 0 : no_pawns);
+}
+
+#endif
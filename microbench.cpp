@@ -0,0 +1,437 @@
+#include <x86intrin.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "huge_pages.hpp"
+#include "perf_counter.hpp"
+#include "perft.hpp"
+#include "pyke.hpp"
+
+using namespace pyke;
+
+// Realistic positions the randomized inputs are drawn from.
+const std::vector<std::string> bench_fens = {
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+	"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+	"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+	"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+	"r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+	"r2q1rk1/pp2bppp/2n1pn2/3p4/3P4/2NBPN2/PP3PPP/R2Q1RK1 b - - 3 10",
+	"2r3k1/5pp1/p3p2p/1p1pP3/3P4/P1R2N1P/1P3PP1/6K1 b - - 0 28",
+	"8/5k2/3p4/1p1Pp2p/pP2Pp1P/P4P1K/8/8 b - - 99 50",
+};
+
+// Positions with the side to move in single check, by a slider at range, a slider in contact, a knight and a pawn.
+const std::vector<std::string> check_fens = {
+	"rnbqkbnr/ppp2ppp/3p4/1B2p3/4P3/8/PPPP1PPP/RNBQK1NR b KQkq - 1 3",
+	"rnb1kbnr/pppp1ppp/8/4p3/4P2q/5P2/PPPP2PP/RNBQKBNR w KQkq - 1 3",
+	"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+	"2r3k1/5pp1/p3p2p/1p1pP3/3P4/P1R2N1P/1P3PP1/2r3K1 w - - 0 28",
+	"r2q1rk1/pp2bppB/2n1pn2/3p4/3P4/2N1PN2/PP3PPP/R2Q1RK1 b - - 0 10",
+	"r1bqkb1r/pppp1ppp/2nN1n2/4p3/2B1P3/8/PPPP1PPP/RNBQK2R b KQkq - 0 5",
+	"8/5k2/3p2P1/1p1Pp2p/pP2Pp1P/P4P1K/8/8 b - - 0 50",
+};
+
+constexpr size_t input_count = 4096;
+
+// Keeps the compiler from optimizing benchmarked results away.
+template <typename T>
+static inline void keep(T const& value) {
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct BenchResult {
+	std::string name;
+	double ns_mean;
+	double ns_stddev;
+	double ns_min;
+	double cycles_mean;
+	// Hardware counters over all samples, with --counters.
+	CounterValues counted;
+	uint64_t ops = 0;
+};
+
+struct BenchConfig {
+	uint64_t iters = 1 << 20;
+	int samples = 15;
+	uint64_t seed = 0x5eed;
+	bool json = false;
+	bool counters = false;
+	std::string label;
+	std::string filter;
+};
+
+// Runs op(i) over the input ring, once per sample, and reports per operation statistics. Expensive operations pass a
+// cost to scale the iteration count down. Cycles are TSC reference cycles; --counters adds the core cycles and other
+// hardware events per operation.
+static BenchResult run_bench(
+	const std::string& name, const BenchConfig& cfg, uint64_t cost, const std::function<void(uint64_t)>& op
+) {
+	uint64_t iters = std::max<uint64_t>(1, cfg.iters / cost);
+	std::vector<double> ns;
+	std::vector<double> cycles;
+	std::unique_ptr<CounterSet> counters = cfg.counters ? std::make_unique<CounterSet>() : nullptr;
+	if (counters) counters->start();
+	for (int s = 0; s < cfg.samples; s++) {
+		auto start = std::chrono::steady_clock::now();
+		uint64_t tsc_start = __rdtsc();
+		for (uint64_t i = 0; i < iters; i++) op(i & (input_count - 1));
+		uint64_t tsc_end = __rdtsc();
+		auto end = std::chrono::steady_clock::now();
+		ns.push_back(std::chrono::duration<double, std::nano>(end - start).count() / iters);
+		cycles.push_back(double(tsc_end - tsc_start) / iters);
+	}
+
+	BenchResult r{name, 0, 0, ns[0], 0};
+	if (counters) {
+		r.counted = counters->stop();
+		r.ops = iters * cfg.samples;
+	}
+	for (int s = 0; s < cfg.samples; s++) {
+		r.ns_mean += ns[s] / cfg.samples;
+		r.cycles_mean += cycles[s] / cfg.samples;
+		r.ns_min = std::min(r.ns_min, ns[s]);
+	}
+	for (double v : ns) r.ns_stddev += (v - r.ns_mean) * (v - r.ns_mean) / cfg.samples;
+	r.ns_stddev = std::sqrt(r.ns_stddev);
+	return r;
+}
+
+// Inputs for a single benchmarked call, drawn from the position suite.
+struct BenchInput {
+	Position* pos;
+	Square from;
+	Square to;
+	BitBoard occ;
+	Piece piece;
+	Piece captured;
+};
+
+static BitBoard random_square_of(BitBoard b, std::mt19937_64& rng) {
+	int n = popcnt(b);
+	int k = rng() % n;
+	while (k--) b &= b - 1;
+	return b & -b;
+}
+
+template <bool white>
+static void make_capture(BenchInput& in) {
+	Board& b = in.pos->board;
+	BitBoard move = square_to_mask(in.from) | square_to_mask(in.to);
+	BitBoard to = square_to_mask(in.to);
+	switch (in.piece) {
+	case PAWN:
+		capture_move_wrapper<white, PAWN>(b, in.captured, move, to);
+		unmake_capture_wrapper<white, PAWN>(b, in.captured, move, to);
+		break;
+	case KNIGHT:
+		capture_move_wrapper<white, KNIGHT>(b, in.captured, move, to);
+		unmake_capture_wrapper<white, KNIGHT>(b, in.captured, move, to);
+		break;
+	case BISHOP:
+		capture_move_wrapper<white, BISHOP>(b, in.captured, move, to);
+		unmake_capture_wrapper<white, BISHOP>(b, in.captured, move, to);
+		break;
+	case ROOK:
+		capture_move_wrapper<white, ROOK>(b, in.captured, move, to);
+		unmake_capture_wrapper<white, ROOK>(b, in.captured, move, to);
+		break;
+	case QUEEN:
+		capture_move_wrapper<white, QUEEN>(b, in.captured, move, to);
+		unmake_capture_wrapper<white, QUEEN>(b, in.captured, move, to);
+		break;
+	case KING:
+		capture_move_wrapper<white, KING>(b, in.captured, move, to);
+		unmake_capture_wrapper<white, KING>(b, in.captured, move, to);
+		break;
+	}
+}
+
+// Bulk counts the piece moves of the side to move, as done at the last ply.
+template <bool white, int dtg>
+static NodeCount count_piece_moves(Position& pos) {
+	MaskSet& msk = create_masks<white>(pos.board, pos.get_ksq<white>(), pos.masks.go_next());
+	NodeCount ret = generate_knight<white, dtg, CountLeaves, 0, all_material>(pos, msk)
+		+ generate_sliders<white, dtg, CountLeaves, 0, all_material>(pos, msk);
+	pos.masks.point_prev();
+	return ret;
+}
+
+// Counts the non-king moves of the side to move in check, through the evasion lookups or through the generators of
+// count_moves outside check with the targets limited to the check mask.
+template <bool white, int dtg, bool evasions>
+static NodeCount count_check_moves(Position& pos) {
+	MaskSet& msk = create_masks<white>(pos.board, pos.get_ksq<white>(), pos.masks.go_next());
+	msk.cmt &= msk.check_mask;
+	NodeCount ret;
+	if constexpr (evasions)
+		ret = generate_evasions<white, dtg, CountLeaves, 0, all_material>(pos, msk);
+	else
+		ret = generate_sliders<white, dtg, CountLeaves, 0, all_material>(pos, msk)
+			+ generate_pawn<white, dtg, CountLeaves, 0, all_material>(pos, msk)
+			+ generate_knight<white, dtg, CountLeaves, 0, all_material>(pos, msk);
+	pos.masks.point_prev();
+	return ret;
+}
+
+template <int dtg, bool evasions>
+static NodeCount count_check_moves(Position& pos) {
+	return pos.white_turn ? count_check_moves<true, dtg, evasions>(pos) : count_check_moves<false, dtg, evasions>(pos);
+}
+
+// Page backing of the lookup tables, and the hardware counters of a perft run that goes through them. Run with
+// PYKE_HUGE_PAGES=0 to compare the dTLB misses against normal pages.
+struct PageReport {
+	PageBacking backing;
+	size_t table_bytes;
+	size_t huge_bytes;
+	NodeCount nodes;
+	double seconds;
+	CounterValues counted;
+};
+
+static PageReport measure_pages(Position& pos, int depth) {
+	PageReport r{lookup_tables_backing, sizeof(lookup_tables), huge_backed_bytes(&lookup_tables), 0, 0, {}};
+	CounterSet counters;
+	counters.start();
+	auto start = std::chrono::steady_clock::now();
+	r.nodes = count_root(pos, depth);
+	r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	r.counted = counters.stop();
+	return r;
+}
+
+// Events per operation as JSON members, with the IPC.
+static void print_json_counters(const CounterValues& v, uint64_t ops) {
+	std::cout << "{\"ipc\": " << v.ipc();
+	for (size_t i = 0; i < counter_count; i++)
+		if (v.valid[i]) std::cout << ", \"" << counter_events[i].name << "\": " << double(v.value[i]) / ops;
+	std::cout << "}";
+}
+
+static void print_results(const std::vector<BenchResult>& results, const BenchConfig& cfg, const PageReport& pages) {
+	bool dtlb_counted = pages.counted.valid[counter_dtlb];
+	double misses_per_mnode = pages.nodes ? pages.counted.value[counter_dtlb] * 1e6 / pages.nodes : 0;
+	if (cfg.json) {
+		std::cout << "{\n  \"label\": \"" << cfg.label << "\",\n  \"backend\": \"pext\",\n  \"compiler\": \""
+				  << __VERSION__ << "\",\n  \"seed\": " << cfg.seed << ",\n  \"iters\": " << cfg.iters
+				  << ",\n  \"samples\": " << cfg.samples << ",\n  \"results\": [\n";
+		for (size_t i = 0; i < results.size(); i++) {
+			const BenchResult& r = results[i];
+			std::cout << "    {\"name\": \"" << r.name << "\", \"ns_per_op\": " << r.ns_mean
+					  << ", \"ns_stddev\": " << r.ns_stddev << ", \"ns_min\": " << r.ns_min
+					  << ", \"cycles_per_op\": " << r.cycles_mean;
+			if (cfg.counters) {
+				std::cout << ", \"counters_per_op\": ";
+				print_json_counters(r.counted, r.ops);
+			}
+			std::cout << "}" << (i + 1 < results.size() ? "," : "") << '\n';
+		}
+		std::cout << "  ],\n  \"pages\": {\"backing\": \"" << backing_name(pages.backing)
+				  << "\", \"table_bytes\": " << pages.table_bytes << ", \"huge_bytes\": " << pages.huge_bytes
+				  << ", \"dtlb_misses_per_mnode\": ";
+		if (dtlb_counted)
+			std::cout << misses_per_mnode;
+		else
+			std::cout << "null";
+		std::cout << "}";
+		if (cfg.counters) {
+			std::cout << ",\n  \"perft\": {\"nodes\": " << pages.nodes
+					  << ", \"mnps\": " << pages.nodes / pages.seconds / 1e6 << ", \"counters_per_node\": ";
+			print_json_counters(pages.counted, pages.nodes);
+			std::cout << "}";
+		}
+		std::cout << "\n}\n";
+	} else {
+		std::cout << std::left << std::setw(34) << "primitive" << std::right << std::setw(12) << "ns/op"
+				  << std::setw(12) << "stddev" << std::setw(12) << "min" << std::setw(14) << "cycles/op" << '\n';
+		std::cout << std::fixed << std::setprecision(3);
+		for (const BenchResult& r : results) {
+			std::cout << std::left << std::setw(34) << r.name << std::right << std::setw(12) << r.ns_mean
+					  << std::setw(12) << r.ns_stddev << std::setw(12) << r.ns_min << std::setw(14) << r.cycles_mean
+					  << '\n';
+		}
+		std::cout << "\nlookup tables: " << pages.table_bytes / 1024 << " KB on " << backing_name(pages.backing) << ", "
+				  << pages.huge_bytes / 1024 << " KB huge page backed\n";
+		if (dtlb_counted)
+			std::cout << "dTLB load misses: " << misses_per_mnode << " per million perft nodes\n";
+		else
+			std::cout << "dTLB load misses: no hardware counter available\n";
+		if (cfg.counters) {
+			std::cout << "\nhardware counters per op:\n";
+			for (const BenchResult& r : results) {
+				std::cout << std::left << std::setw(34) << r.name << std::right;
+				if (!r.counted.any()) {
+					std::cout << "not available\n";
+					continue;
+				}
+				std::cout << "IPC " << r.counted.ipc();
+				for (size_t i = 0; i < counter_count; i++) {
+					if (r.counted.valid[i])
+						std::cout << ", " << counter_events[i].name << ' ' << double(r.counted.value[i]) / r.ops;
+				}
+				std::cout << '\n';
+			}
+			std::cout << "\nperft " << pages.nodes << " nodes, " << std::setprecision(1)
+					  << pages.nodes / pages.seconds / 1e6 << " MNPS\n";
+			print_counters(std::cout, pages.counted, pages.nodes, pages.seconds);
+		}
+	}
+}
+
+int main(int argc, char* argv[]) {
+	BenchConfig cfg;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--json") {
+			cfg.json = true;
+		} else if (arg == "--counters") {
+			cfg.counters = true;
+		} else if (arg == "--iters" && i + 1 < argc) {
+			cfg.iters = std::stoull(argv[++i]);
+		} else if (arg == "--samples" && i + 1 < argc) {
+			cfg.samples = std::max(1, std::stoi(argv[++i]));
+		} else if (arg == "--seed" && i + 1 < argc) {
+			cfg.seed = std::stoull(argv[++i]);
+		} else if (arg == "--label" && i + 1 < argc) {
+			cfg.label = argv[++i];
+		} else if (arg == "--filter" && i + 1 < argc) {
+			cfg.filter = argv[++i];
+		} else {
+			std::cout << "Usage: microbench [--json] [--counters] [--iters N] [--samples N] [--seed N] [--label S] "
+						 "[--filter S]\n";
+			return 1;
+		}
+	}
+
+	std::vector<Position> positions(bench_fens.size());
+	for (size_t i = 0; i < bench_fens.size(); i++) positions[i].load_fen(bench_fens[i]);
+	std::vector<Position> check_positions(check_fens.size());
+	for (size_t i = 0; i < check_fens.size(); i++) {
+		Position& pos = check_positions[i];
+		pos.load_fen(check_fens[i]);
+		if (count_check_moves<2, true>(pos) != count_check_moves<2, false>(pos)) {
+			std::cerr << "evasion count mismatch in " << check_fens[i] << '\n';
+			return 1;
+		}
+	}
+
+	// Draw the inputs up front so the measured loops only run the primitives.
+	std::mt19937_64 rng(cfg.seed);
+	std::vector<BenchInput> inputs(input_count);
+	std::vector<BenchInput> captures(input_count);
+	std::vector<BenchInput> doubles;
+	std::vector<Position*> in_check(input_count);
+	for (size_t i = 0; i < input_count; i++) {
+		Position& pos = positions[rng() % positions.size()];
+		inputs[i] = {&pos, Square(rng() % 64), 0, pos.board.occ_board, EMPTY, EMPTY};
+		in_check[i] = &check_positions[rng() % check_positions.size()];
+
+		// A capture of a random enemy non-king piece by a random own piece.
+		Position* cpos;
+		BitBoard own, opp;
+		do {
+			cpos = &positions[rng() % positions.size()];
+			bool white = cpos->white_turn;
+			own = cpos->board.get_player_occ<true>();
+			opp = cpos->board.get_player_occ<false>() & ~cpos->board.b_king;
+			if (!white) {
+				own = cpos->board.get_player_occ<false>();
+				opp = cpos->board.get_player_occ<true>() & ~cpos->board.w_king;
+			}
+		} while (!opp);
+		Square from = lbit(random_square_of(own, rng));
+		Square to = lbit(random_square_of(opp, rng));
+		Board& cb = cpos->board;
+		Piece piece = cpos->white_turn ? cb.get_piece<true>(from) : cb.get_piece<false>(from);
+		Piece captured = cpos->white_turn ? cb.get_piece<false>(to) : cb.get_piece<true>(to);
+		captures[i] = {cpos, from, to, cb.occ_board, piece, captured};
+	}
+
+	// Double pushes available in the suite, repeated to fill the input ring.
+	for (Position& pos : positions) {
+		BitBoard pawns = pos.white_turn ? pos.board.w_pawn & pawn_start_w : pos.board.b_pawn & pawn_start_b;
+		while (pawns) {
+			BitBoard from = popextr(pawns);
+			BitBoard to = pos.white_turn ? get_pawn_double<true>(from, pos.board.occ_board)
+										 : get_pawn_double<false>(from, pos.board.occ_board);
+			if (to) doubles.push_back({&pos, lbit(from), lbit(to), pos.board.occ_board, PAWN, EMPTY});
+		}
+	}
+	for (size_t i = doubles.size(); i < input_count; i++) doubles.push_back(doubles[rng() % i]);
+	std::shuffle(doubles.begin(), doubles.end(), rng);
+
+	std::vector<BenchResult> results;
+	auto bench = [&](const std::string& name, uint64_t cost, const std::function<void(uint64_t)>& op) {
+		if (name.find(cfg.filter) == std::string::npos) return;
+		results.push_back(run_bench(name, cfg, cost, op));
+	};
+
+	bench("get_rook_move", 1, [&](uint64_t i) { keep(get_rook_move(inputs[i].from, inputs[i].occ)); });
+	bench("get_bishop_move", 1, [&](uint64_t i) { keep(get_bishop_move(inputs[i].from, inputs[i].occ)); });
+	bench("create_masks", 1, [&](uint64_t i) {
+		Position& pos = *inputs[i].pos;
+		MaskSet msk;
+		if (pos.white_turn)
+			keep(create_masks<true>(pos.board, pos.get_ksq<true>(), msk).nopin);
+		else
+			keep(create_masks<false>(pos.board, pos.get_ksq<false>(), msk).nopin);
+	});
+	bench("Position::is_attacked", 1, [&](uint64_t i) {
+		Position& pos = *inputs[i].pos;
+		keep(pos.white_turn ? pos.is_attacked<true>(inputs[i].from) : pos.is_attacked<false>(inputs[i].from));
+	});
+	bench("Position::king_danger", 1, [&](uint64_t i) {
+		Position& pos = *inputs[i].pos;
+		keep(pos.white_turn ? pos.king_danger<true>(get_king_move(pos.wksq) & ~pos.board.w_board)
+							: pos.king_danger<false>(get_king_move(pos.bksq) & ~pos.board.b_board));
+	});
+	bench("capture_move_wrapper+unmake", 1, [&](uint64_t i) {
+		BenchInput& in = captures[i];
+		if (in.pos->white_turn)
+			make_capture<true>(in);
+		else
+			make_capture<false>(in);
+		keep(in.pos->board.occ_board);
+	});
+	bench("pawn_double+unmake", 1, [&](uint64_t i) {
+		BenchInput& in = doubles[i];
+		Board& b = in.pos->board;
+		BitBoard move = square_to_mask(in.from) | square_to_mask(in.to);
+		if (in.pos->white_turn) {
+			keep(pawn_double<true>(b, move, square_to_mask(in.to), in.pos->ep_flag));
+			unmake_pawn_double<true>(b, move);
+		} else {
+			keep(pawn_double<false>(b, move, square_to_mask(in.to), in.pos->ep_flag));
+			unmake_pawn_double<false>(b, move);
+		}
+		in.pos->ep_flag = 0;
+	});
+	bench("generate_moves (dtg 1)", 4, [&](uint64_t i) {
+		Position& pos = *inputs[i].pos;
+		keep(pos.white_turn ? count_piece_moves<true, 1>(pos) : count_piece_moves<false, 1>(pos));
+	});
+	bench("generate_moves (dtg 2)", 64, [&](uint64_t i) {
+		Position& pos = *inputs[i].pos;
+		keep(pos.white_turn ? count_piece_moves<true, 2>(pos) : count_piece_moves<false, 2>(pos));
+	});
+	bench("generators in check (dtg 1)", 4, [&](uint64_t i) { keep(count_check_moves<1, false>(*in_check[i])); });
+	bench("generate_evasions (dtg 1)", 4, [&](uint64_t i) { keep(count_check_moves<1, true>(*in_check[i])); });
+	bench("generators in check (dtg 2)", 64, [&](uint64_t i) { keep(count_check_moves<2, false>(*in_check[i])); });
+	bench("generate_evasions (dtg 2)", 64, [&](uint64_t i) { keep(count_check_moves<2, true>(*in_check[i])); });
+
+	print_results(results, cfg, measure_pages(positions[1], 4));
+	return 0;
+}
@@ -1,36 +1,45 @@
 #include <cstdint>
+#include <string>
 
 #include "defaults.hpp"
+#include "util.hpp"
 
 #ifndef MOVE_H
 #define MOVE_H
 
+// Move types.
+#define MOVE_NORMAL	   0
+#define MOVE_DOUBLE	   1
+#define MOVE_EP		   2
+#define MOVE_CASTLE	   3
+#define MOVE_PROMOTION 4
+
+// Packed move. 6 bits from square, 6 bits to square, then 3 bits each for the moving piece, the captured piece,
+// the promotion piece and the move type.
 struct Move {
 	Move() {};
-	/*
-	Move(MoveType t, Piece p) {
-		set_type(t);
-		set_piece(p);
+	Move(MoveType t, Piece p, Square from, Square to, Piece captured = EMPTY, Piece promotion = EMPTY) {
+		data = from | (to << 6) | (p << 12) | (captured << 15) | (promotion << 18) | (t << 21);
 	}
-	Move(Piece p) { set_piece(p); }
-	Move(MoveType t, Piece p, Square f, Square to) {
-		set_type(t);
-		set_piece(p);
-		set_from(f);
-		set_to(to);
+
+	inline Square get_from() const { return data & 0b111111; }
+	inline Square get_to() const { return (data >> 6) & 0b111111; }
+	inline Piece get_piece() const { return (data >> 12) & 0b111; }
+	inline Piece get_captured() const { return (data >> 15) & 0b111; }
+	inline Piece get_promotion() const { return (data >> 18) & 0b111; }
+	inline MoveType get_type() const { return (data >> 21) & 0b111; }
+	inline bool is_null() const { return !data; }
+
+	bool operator==(const Move& other) const { return data == other.data; }
+
+	// Long algebraic notation, as used by UCI.
+	std::string to_string() const {
+		constexpr char promotion_chars[] = " pkrbnq";
+		std::string ret = make_chess_notation(get_from()) + make_chess_notation(get_to());
+		if (get_promotion() != EMPTY) ret += promotion_chars[get_promotion()];
+		return ret;
 	}
-	inline void set_to(Square s) { data = (data & ~(0xFD << 16)) | ((s) << 16); }
-	inline void set_piece(Piece p) { data = (data & ~(0b101 << 13)) | ((p) << 13); }
-	inline void set_from(Square f) { data = data & ~(0xFD << 24) | (f) << 24; }
-	inline void set_type(uint8_t t) { data = data & ~(0b101) | t; }
-	inline void set_content(uint8_t c) { data = data & ~(0b101 << 8) | c << 8; }
-
-	inline Square get_to() const { return (data >> 14) & 0b1111'1111; }
-	inline Square get_from() const { return (data >> 22) & 0b1111'1111; }
-	inline MoveType get_type() const { return data & 0b101; }
-	inline uint8_t get_content() const { return (data >> 6) & 0b1111; }
-	inline Piece get_piece() const { return (data >> 11) & 0b111; }
-*/
+
 private:
 	uint32_t data = 0b0;
 };
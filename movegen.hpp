@@ -0,0 +1,271 @@
+#include <array>
+#include <cstdint>
+
+#include "gamestate.hpp"
+#include "make_move.hpp"
+#include "maskset.hpp"
+#include "move.hpp"
+#include "piece_moves.hpp"
+#include "position.hpp"
+#include "util.hpp"
+
+#ifndef MOVEGEN_H
+#define MOVEGEN_H
+
+// Fixed capacity move list. No legal position has more than 218 moves.
+struct MoveBuffer {
+	Move moves[256];
+	int count = 0;
+
+	inline void push(Move m) { moves[count++] = m; }
+	inline void clear() { count = 0; }
+	inline int size() const { return count; }
+	inline Move* begin() { return moves; }
+	inline Move* end() { return moves + count; }
+	inline Move& operator[](int i) { return moves[i]; }
+};
+
+// State a move can not restore by itself.
+struct MoveUndo {
+	CastlingRights castling_rights;
+	uint8_t ep_flag;
+};
+
+// Castling rights that survive a move from or to each square.
+inline constexpr std::array<CastlingRights, 64> castling_keep = [] {
+	std::array<CastlingRights, 64> ret{};
+	for (auto& r : ret) r = 0b1111;
+	ret[king_start_squares[0]] = rm_cr_w(0b1111);
+	ret[king_start_squares[2]] = rm_cr_b(0b1111);
+	ret[rook_start_squares[0]] = rm_cr_wk(0b1111);
+	ret[rook_start_squares[1]] = rm_cr_wq(0b1111);
+	ret[rook_start_squares[2]] = rm_cr_bk(0b1111);
+	ret[rook_start_squares[3]] = rm_cr_bq(0b1111);
+	return ret;
+}();
+
+namespace pyke {
+
+/*
+ *	GENERATION
+ */
+
+// Adds a move of the given piece per target square.
+template <bool white, Piece p>
+static inline void add_moves(Square from, BitBoard targets, Board& b, MoveBuffer& out) {
+	while (targets) {
+		Square to = pop(targets);
+		out.push(Move(MOVE_NORMAL, p, from, to, b.get_piece<!white>(to)));
+	}
+}
+
+// Moves of every piece in pieces onto squares in cmt. The reach of pinned queens is given by mt.
+template <bool white, Piece p, MoveType mt = p>
+static inline void add_piece_moves(BitBoard cmt, BitBoard pieces, Board& b, MoveBuffer& out) {
+	if (!cmt) return;
+	while (pieces) {
+		Square from = pop(pieces);
+		add_moves<white, p>(from, cmt & make_reach_board<white, mt>(from, b), b, out);
+	}
+}
+
+// Pushes, double pushes, captures and promotions of the given pawns onto squares in cmt.
+template <bool white>
+static inline void add_pawn_moves(BitBoard cmt, BitBoard pawns, Board& b, MoveBuffer& out) {
+	if (!cmt) return;
+	BitBoard occ = b.occ_board;
+	while (pawns) {
+		Square from = pop(pawns);
+		BitBoard from_mask = square_to_mask(from);
+		BitBoard targets = ((get_pawn_move<white, PawnMoveType::ATTACKS>(from, occ) & occ)
+							| (get_pawn_forward<white>(from_mask) & ~occ))
+			& cmt;
+		while (targets) {
+			Square to = pop(targets);
+			Piece captured = b.get_piece<!white>(to);
+			if (square_to_mask(to) & promotion_to_squares) {
+				for (Piece promotion : promotion_pieces) out.push(Move(MOVE_PROMOTION, PAWN, from, to, captured, promotion));
+			} else {
+				out.push(Move(MOVE_NORMAL, PAWN, from, to, captured));
+			}
+		}
+		if (from_mask & (white ? pawn_start_w : pawn_start_b)) {
+			BitBoard to = get_pawn_double<white>(from_mask, occ) & cmt;
+			if (to) out.push(Move(MOVE_DOUBLE, PAWN, from, lbit(to)));
+		}
+	}
+}
+
+// King steps are tested with the king lifted from the occupancy, castling with the same rules as count_moves.
+template <bool white>
+static inline void add_king_moves(Position& pos, BitBoard cmt, bool in_check, MoveBuffer& out) {
+	Board& b = pos.board;
+	Square ksq = pos.get_ksq<white>();
+	BitBoard targets = get_king_move(ksq) & cmt;
+	b.occ_board ^= square_to_mask(ksq);
+	while (targets) {
+		Square to = pop(targets);
+		if (!pos.is_attacked<white>(to)) out.push(Move(MOVE_NORMAL, KING, ksq, to, b.get_piece<!white>(to)));
+	}
+	b.occ_board ^= square_to_mask(ksq);
+	if (in_check) return;
+
+	for (bool kingside : {true, false}) {
+		uint8_t code = white ? (kingside ? 0 : 1) : (kingside ? 2 : 3);
+		Square to = king_end_squares[code];
+		Square middle_square = rook_end_squares[code];
+		CastlingRights right = white ? (kingside ? wk_mask : wq_mask) : (kingside ? bk_mask : bq_mask);
+		if (!(pos.castling_rights & right)) continue;
+		if (b.square_occ(to) || b.square_occ(middle_square)) continue;
+		if (!kingside && b.square_occ(queenside_middle_squares[white])) continue;
+		if (pos.is_attacked<white>(middle_square) || pos.is_attacked<white>(to)) continue;
+		out.push(Move(MOVE_CASTLE, KING, ksq, to));
+	}
+}
+
+// Ep captures are made and tested, as they can uncover the king along the rank of both pawns.
+template <bool white, int offset>
+static inline void add_ep_move(Position& pos, MoveBuffer& out) {
+	sq_pair epsq = get_ep_squares<white, offset>(pos.ep_flag);
+	BitBoard move = square_to_mask(epsq.first) | square_to_mask(epsq.second);
+	BitBoard capture_sq = square_to_mask(white ? epsq.second + 8 : epsq.second - 8);
+
+	ep_move<white>(pos.board, move, capture_sq);
+	bool legal = !pos.is_attacked<white>(pos.get_ksq<white>());
+	unmake_ep_move<white>(pos.board, move, capture_sq);
+	if (legal) out.push(Move(MOVE_EP, PAWN, epsq.first, epsq.second, PAWN));
+}
+
+// Fills out with the legal moves of the side to move, using the castling rights and ep flag stored in pos. Uses the
+// same masks as count_moves, for callers that need the moves themselves instead of a count.
+template <bool white>
+void generate_legal_moves(Position& pos, MoveBuffer& out) {
+	out.clear();
+	Board& b = pos.board;
+	MaskSet msk;
+	create_masks<white>(b, pos.get_ksq<white>(), msk);
+	add_king_moves<white>(pos, msk.cmt, msk.checkers, out);
+
+	switch (msk.checkers) {
+	case 0:
+		break;
+	case 1:
+		msk.cmt &= msk.check_mask;
+		break;
+	default:
+		return;
+	}
+
+	BitBoard queens = pos.piece_brd<white, QUEEN>();
+	BitBoard rooks = pos.piece_brd<white, ROOK>();
+	BitBoard bishops = pos.piece_brd<white, BISHOP>();
+	BitBoard pawns = pos.piece_brd<white, PAWN>();
+	BitBoard pin_cmt_diag = msk.cmt & msk.pinmask_dg;
+	BitBoard pin_cmt_orth = msk.cmt & msk.pinmask_orth;
+	BitBoard dg_not_orth = msk.pinmask_dg & ~msk.pinmask_orth;
+	BitBoard orth_not_dg = msk.pinmask_orth & ~msk.pinmask_dg;
+
+	// Unpinned + pinned.
+	add_piece_moves<white, QUEEN>(msk.cmt, queens & msk.nopin, b, out);
+	add_piece_moves<white, QUEEN, QUEEN_DIAG>(pin_cmt_diag, queens & dg_not_orth, b, out);
+	add_piece_moves<white, QUEEN, QUEEN_ORTH>(pin_cmt_orth, queens & orth_not_dg, b, out);
+	add_piece_moves<white, ROOK>(msk.cmt, rooks & msk.nopin, b, out);
+	add_piece_moves<white, ROOK>(pin_cmt_orth, rooks & orth_not_dg, b, out);
+	add_piece_moves<white, BISHOP>(msk.cmt, bishops & msk.nopin, b, out);
+	add_piece_moves<white, BISHOP>(pin_cmt_diag, bishops & dg_not_orth, b, out);
+	add_piece_moves<white, KNIGHT>(msk.cmt, pos.piece_brd<white, KNIGHT>() & msk.nopin, b, out);
+	add_pawn_moves<white>(msk.cmt, pawns & msk.nopin, b, out);
+	add_pawn_moves<white>(pin_cmt_diag, pawns & msk.pinmask_dg, b, out);
+	add_pawn_moves<white>(pin_cmt_orth, pawns & msk.pinmask_orth, b, out);
+
+	if (pos.ep_flag & 0x80) add_ep_move<white, -1>(pos, out);
+	if (pos.ep_flag & 0x40) add_ep_move<white, 1>(pos, out);
+}
+
+// Runtime wrapper for the side to move.
+inline void generate_legal_moves(Position& pos, MoveBuffer& out) {
+	if (pos.white_turn)
+		generate_legal_moves<true>(pos, out);
+	else
+		generate_legal_moves<false>(pos, out);
+}
+
+/*
+ *	MAKE / UNMAKE
+ */
+
+static inline void toggle_piece(Board& b, bool white, Piece p, Square s) {
+	BitBoard mask = square_to_mask(s);
+	*b.get_board_pointer(white, p) ^= mask;
+	(white ? b.w_board : b.b_board) ^= mask;
+	b.occ_board ^= mask;
+}
+
+// Moves the pieces of m on the board, without touching any other state. Applying it twice restores the board.
+template <bool white>
+static inline void toggle_move(Board& b, Move m) {
+	Square from = m.get_from();
+	Square to = m.get_to();
+	switch (m.get_type()) {
+	case MOVE_EP:
+		toggle_piece(b, !white, PAWN, white ? to + 8 : to - 8);
+		break;
+	case MOVE_CASTLE: {
+		uint8_t code = white ? (to == king_end_squares[0] ? 0 : 1) : (to == king_end_squares[2] ? 2 : 3);
+		toggle_piece(b, white, ROOK, rook_start_squares[code]);
+		toggle_piece(b, white, ROOK, rook_end_squares[code]);
+		break;
+	}
+	default:
+		if (m.get_captured() != EMPTY) toggle_piece(b, !white, m.get_captured(), to);
+	}
+	toggle_piece(b, white, m.get_piece(), from);
+	toggle_piece(b, white, m.get_type() == MOVE_PROMOTION ? m.get_promotion() : m.get_piece(), to);
+}
+
+// Plays a move from generate_legal_moves. Updates castling rights, ep flag, king square and side to move, and returns
+// what unmake_move needs to restore them.
+template <bool white>
+inline MoveUndo make_move(Position& pos, Move m) {
+	MoveUndo undo{pos.castling_rights, pos.ep_flag};
+	toggle_move<white>(pos.board, m);
+	if (m.get_piece() == KING) pos.set_ksq<white>(m.get_to());
+	pos.castling_rights &= castling_keep[m.get_from()] & castling_keep[m.get_to()];
+
+	// Same ep encoding as pawn_double: only set when an enemy pawn stands next to the pushed pawn.
+	pos.ep_flag = 0;
+	if (m.get_type() == MOVE_DOUBLE) {
+		Square to = m.get_to();
+		File file = to % 8;
+		BitBoard opp_pawns = pos.board.get_piece_board<!white, PAWN>();
+		if (file > 0 && (opp_pawns & square_to_mask(to - 1))) set_en_passant(true, file, pos.ep_flag);
+		if (file < 7 && (opp_pawns & square_to_mask(to + 1))) set_en_passant(false, file, pos.ep_flag);
+	}
+	pos.white_turn = !white;
+	return undo;
+}
+
+template <bool white>
+inline void unmake_move(Position& pos, Move m, MoveUndo undo) {
+	toggle_move<white>(pos.board, m);
+	if (m.get_piece() == KING) pos.set_ksq<white>(m.get_from());
+	pos.castling_rights = undo.castling_rights;
+	pos.ep_flag = undo.ep_flag;
+	pos.white_turn = white;
+}
+
+inline MoveUndo make_move(Position& pos, Move m) {
+	return pos.white_turn ? make_move<true>(pos, m) : make_move<false>(pos, m);
+}
+
+// Takes back a move of the side that is not to move anymore.
+inline void unmake_move(Position& pos, Move m, MoveUndo undo) {
+	if (pos.white_turn)
+		unmake_move<false>(pos, m, undo);
+	else
+		unmake_move<true>(pos, m, undo);
+}
+
+};	// namespace pyke
+
+#endif
@@ -0,0 +1,82 @@
+#include <cstdint>
+
+#include "board.hpp"
+#include "defaults.hpp"
+#include "position.hpp"
+#include "util.hpp"
+
+#ifndef PACKED_POSITION_H
+#define PACKED_POSITION_H
+
+// Everything that defines the subtree of a position, in 32 bytes: the occupancy, one nibble per occupied square in
+// square order (piece in the low 3 bits, white in the high bit), and the castling rights, ep flag and side to move.
+// Positions reached by different move orders pack to the same bytes, so they can be compared and hashed directly.
+struct PackedPosition {
+	uint64_t occ = 0;
+	uint64_t pieces[2] = {0, 0};
+	uint64_t state = 0;
+
+	bool operator==(const PackedPosition& other) const {
+		return occ == other.occ && pieces[0] == other.pieces[0] && pieces[1] == other.pieces[1]
+			&& state == other.state;
+	}
+
+	bool operator<(const PackedPosition& other) const {
+		if (occ != other.occ) return occ < other.occ;
+		if (pieces[0] != other.pieces[0]) return pieces[0] < other.pieces[0];
+		if (pieces[1] != other.pieces[1]) return pieces[1] < other.pieces[1];
+		return state < other.state;
+	}
+
+	uint64_t hash() const {
+		uint64_t h = occ * 0x9E3779B97F4A7C15ULL;
+		h = (h ^ pieces[0]) * 0xBF58476D1CE4E5B9ULL;
+		h = (h ^ pieces[1]) * 0x94D049BB133111EBULL;
+		h ^= state;
+		h ^= h >> 31;
+		h *= 0x9E3779B97F4A7C15ULL;
+		return h ^ (h >> 29);
+	}
+};
+
+static inline PackedPosition pack_position(Position& pos) {
+	PackedPosition ret;
+	Board& b = pos.board;
+	ret.occ = b.occ_board;
+	BitBoard occ = b.occ_board;
+	for (int i = 0; occ && i < 32; i++) {
+		Square s = pop(occ);
+		bool white = b.w_board & square_to_mask(s);
+		uint64_t nibble = (white ? b.get_piece<true>(s) : b.get_piece<false>(s)) | (white << 3);
+		ret.pieces[i / 16] |= nibble << (i % 16 * 4);
+	}
+	ret.state = pos.castling_rights | (uint64_t(pos.ep_flag) << 8) | (uint64_t(pos.white_turn) << 16);
+	return ret;
+}
+
+// Overwrites the board and game state of pos. The mask stack is left as is.
+static inline void unpack_position(const PackedPosition& packed, Position& pos) {
+	Board& b = pos.board;
+	for (Piece p = PAWN; p <= QUEEN; p++) {
+		*b.get_board_pointer(true, p) = 0;
+		*b.get_board_pointer(false, p) = 0;
+	}
+	b.w_board = b.b_board = 0;
+	b.occ_board = packed.occ;
+
+	BitBoard occ = packed.occ;
+	for (int i = 0; occ && i < 32; i++) {
+		Square s = pop(occ);
+		uint8_t nibble = (packed.pieces[i / 16] >> (i % 16 * 4)) & 0xF;
+		bool white = nibble & 0b1000;
+		Piece p = nibble & 0b111;
+		*b.get_board_pointer(white, p) |= square_to_mask(s);
+		(white ? b.w_board : b.b_board) |= square_to_mask(s);
+		if (p == KING) (white ? pos.wksq : pos.bksq) = s;
+	}
+	pos.castling_rights = packed.state & 0xF;
+	pos.ep_flag = (packed.state >> 8) & 0xFF;
+	pos.white_turn = (packed.state >> 16) & 1;
+}
+
+#endif
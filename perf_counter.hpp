@@ -0,0 +1,237 @@
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef PERF_COUNTER_H
+#define PERF_COUNTER_H
+
+inline constexpr uint64_t cache_event(uint64_t cache, uint64_t op, uint64_t result) {
+	return cache | (op << 8) | (result << 16);
+}
+
+inline constexpr uint64_t dtlb_read_misses =
+	cache_event(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS);
+
+// One event of the calling thread in user space, through perf_event_open. available() is false when the kernel or a
+// virtual machine does not expose the event, and reads then return 0. Reads are scaled up when the kernel multiplexes
+// more events than the PMU has counters.
+struct PerfCounter {
+	PerfCounter(uint32_t type, uint64_t config) {
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+	~PerfCounter() {
+		if (fd >= 0) close(fd);
+	}
+	PerfCounter(const PerfCounter&) = delete;
+	PerfCounter& operator=(const PerfCounter&) = delete;
+
+	bool available() const { return fd >= 0; }
+
+	// Counts from zero.
+	void start() {
+		if (fd < 0) return;
+		ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+		enable();
+	}
+
+	uint64_t stop() {
+		disable();
+		return read();
+	}
+
+	// Counts on from the current value.
+	void enable() {
+		if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+
+	void disable() {
+		if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+	}
+
+	uint64_t read() const {
+		uint64_t data[3];
+		if (fd < 0 || ::read(fd, data, sizeof(data)) != sizeof(data)) return 0;
+		if (!data[2]) return 0;
+		return data[2] == data[1] ? data[0] : uint64_t(double(data[0]) * data[1] / data[2]);
+	}
+
+private:
+	int fd = -1;
+};
+
+// The events of a CounterSet, in report order. There is no generic L2 event, so L2 misses are counted as the loads
+// that reach the last level cache.
+struct CounterEvent {
+	const char* name;
+	uint32_t type;
+	uint64_t config;
+};
+
+inline constexpr CounterEvent counter_events[] = {
+	{"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+	{"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+	{"L1d misses", PERF_TYPE_HW_CACHE,
+	 cache_event(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+	{"L2 misses", PERF_TYPE_HW_CACHE,
+	 cache_event(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_ACCESS)},
+	{"LLC misses", PERF_TYPE_HW_CACHE,
+	 cache_event(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+	{"branch misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+	{"dTLB misses", PERF_TYPE_HW_CACHE, dtlb_read_misses},
+};
+
+inline constexpr size_t counter_count = std::size(counter_events);
+inline constexpr size_t counter_cycles = 0;
+inline constexpr size_t counter_instructions = 1;
+inline constexpr size_t counter_dtlb = 6;
+
+struct CounterValues {
+	std::array<uint64_t, counter_count> value{};
+	std::array<bool, counter_count> valid{};
+
+	bool any() const {
+		for (bool v : valid)
+			if (v) return true;
+		return false;
+	}
+
+	double ipc() const {
+		return valid[counter_cycles] && valid[counter_instructions] && value[counter_cycles]
+				 ? double(value[counter_instructions]) / value[counter_cycles]
+				 : 0;
+	}
+
+	CounterValues& operator+=(const CounterValues& other) {
+		for (size_t i = 0; i < counter_count; i++) {
+			value[i] += other.value[i];
+			valid[i] = valid[i] || other.valid[i];
+		}
+		return *this;
+	}
+};
+
+// Every event of counter_events for the thread that creates the set. Events are opened one by one, so a machine that
+// exposes only some of them still reports those.
+struct CounterSet {
+	CounterSet() {
+		for (size_t i = 0; i < counter_count; i++)
+			counters[i] = std::make_unique<PerfCounter>(counter_events[i].type, counter_events[i].config);
+	}
+
+	void start() {
+		for (auto& c : counters) c->start();
+	}
+
+	CounterValues stop() {
+		pause();
+		return read();
+	}
+
+	void resume() {
+		for (auto& c : counters) c->enable();
+	}
+
+	void pause() {
+		for (auto& c : counters) c->disable();
+	}
+
+	CounterValues read() const {
+		CounterValues v;
+		for (size_t i = 0; i < counter_count; i++) {
+			v.valid[i] = counters[i]->available();
+			v.value[i] = counters[i]->read();
+		}
+		return v;
+	}
+
+private:
+	std::array<std::unique_ptr<PerfCounter>, counter_count> counters;
+};
+
+// Counter sets of the threads of a pool, by thread id. Each set is opened by its own thread on first use, as perf
+// events follow the thread that opened them.
+struct ThreadCounters {
+	explicit ThreadCounters(unsigned threads) : sets(threads) {}
+
+	void resume(unsigned thread) {
+		if (!sets[thread]) sets[thread] = std::make_unique<CounterSet>();
+		sets[thread]->resume();
+	}
+
+	void pause(unsigned thread) { sets[thread]->pause(); }
+
+	CounterValues of(unsigned thread) const { return sets[thread] ? sets[thread]->read() : CounterValues(); }
+
+	CounterValues total() const {
+		CounterValues sum;
+		for (unsigned t = 0; t < sets.size(); t++) sum += of(t);
+		return sum;
+	}
+
+	unsigned size() const { return sets.size(); }
+
+private:
+	std::vector<std::unique_ptr<CounterSet>> sets;
+};
+
+// Set by PYKE_COUNTERS=1, for tools that have no flags of their own.
+inline bool counters_requested() {
+	static const bool requested = [] {
+		const char* env = std::getenv("PYKE_COUNTERS");
+		return env && std::strcmp(env, "0");
+	}();
+	return requested;
+}
+
+// IPC, then every available event per node and per second. Lines start with prefix, e.g. "info string " for UCI.
+inline void print_counters(std::ostream& out, const CounterValues& v, uint64_t nodes, double seconds,
+						   const std::string& prefix = "") {
+	if (!v.any()) {
+		out << prefix << "hardware counters: not available\n";
+		return;
+	}
+	std::ostringstream text;
+	text << std::fixed;
+	if (v.ipc() > 0) text << prefix << "IPC: " << std::setprecision(2) << v.ipc() << '\n';
+	for (size_t i = 0; i < counter_count; i++) {
+		if (!v.valid[i]) continue;
+		double per_node = nodes ? double(v.value[i]) / nodes : 0;
+		double per_second = seconds > 0 ? v.value[i] / seconds : 0;
+		text << prefix << counter_events[i].name << ": " << std::setprecision(3) << per_node << " per node, "
+			 << std::setprecision(1) << per_second / 1e6 << " M/s\n";
+	}
+	out << text.str();
+}
+
+// Counts of one thread on a single line.
+inline std::string counter_summary(const CounterValues& v) {
+	if (!v.any()) return "no counters";
+	std::ostringstream text;
+	text << std::fixed << std::setprecision(2) << "IPC " << v.ipc();
+	for (size_t i = 0; i < counter_count; i++)
+		if (v.valid[i]) text << ", " << counter_events[i].name << ' ' << v.value[i];
+	return text.str();
+}
+
+#endif
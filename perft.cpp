@@ -0,0 +1,36 @@
+#include "perft.hpp"
+
+template <bool print_move>
+static NodeCount count_root(Position& pos, int depth) {
+	switch (depth) {
+	case 0:
+		return 1;
+	case 1:
+		return count_root<1, print_move>(pos);
+	case 2:
+		return count_root<2, print_move>(pos);
+	case 3:
+		return count_root<3, print_move>(pos);
+	case 4:
+		return count_root<4, print_move>(pos);
+	case 5:
+		return count_root<5, print_move>(pos);
+	case 6:
+		return count_root<6, print_move>(pos);
+	case 7:
+		return count_root<7, print_move>(pos);
+	case 8:
+		return count_root<8, print_move>(pos);
+	case 9:
+		return count_root<9, print_move>(pos);
+	case 10:
+		return count_root<10, print_move>(pos);
+	default:
+		std::cout << "Depth above 10 not supported." << std::endl;
+		return 0;
+	}
+}
+
+NodeCount count_root(Position& pos, int depth, bool print_move) {
+	return print_move ? count_root<true>(pos, depth) : count_root<false>(pos, depth);
+}
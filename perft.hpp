@@ -3,53 +3,89 @@
 #include <cstdint>
 #include <ctime>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
 
+#include "perf_counter.hpp"
 #include "pyke.hpp"
 
-template <int depth>
-static uint64_t perft_internal(Position& pos) {
-	clock_t start = clock();
-	uint64_t nodes;
+#ifndef PERFT_H
+#define PERFT_H
 
+// Root call with the side to move and ep flag of the position. The ep flag is restored afterwards, as double pushes in
+// the tree overwrite it.
+template <int depth, TreeVisitor V, CastlingRights cr, MaterialMask mat>
+static NodeCount walk_node(Position& pos) {
+	uint8_t ep_flag = pos.ep_flag;
+	NodeCount nodes;
 	if (pos.white_turn)
-		nodes = pyke::count_moves<true, depth, true, make_cr_flag(1, 1, 1, 1)>(pos);
+		nodes = ep_flag ? pyke::count_moves<true, depth, V, cr, mat, true>(pos)
+						: pyke::count_moves<true, depth, V, cr, mat, false>(pos);
+	else
+		nodes = ep_flag ? pyke::count_moves<false, depth, V, cr, mat, true>(pos)
+						: pyke::count_moves<false, depth, V, cr, mat, false>(pos);
+	pos.ep_flag = ep_flag;
+	return nodes;
+}
+
+// Matches the material signature against each template value in turn.
+template <int depth, TreeVisitor V, MaterialMask mat = 0>
+static NodeCount walk_material(Position& pos, MaterialMask signature) {
+	if constexpr (mat < max_material) {
+		if (signature != mat) return walk_material<depth, V, mat + 1>(pos, signature);
+	}
+	return walk_node<depth, V, 0, mat>(pos);
+}
+
+// Root call of a walk with visitor V. The castling rights are matched against each template value in turn. Without
+// castling rights the walk is specialized on the material signature as well; with them it keeps all generators, which
+// bounds the number of instantiations.
+template <int depth, TreeVisitor V, CastlingRights cr = 0>
+static NodeCount walk_root(Position& pos) {
+	if constexpr (cr < 0b1111) {
+		if (pos.castling_rights != cr) return walk_root<depth, V, cr + 1>(pos);
+	}
+	if constexpr (cr == 0)
+		return walk_material<depth, V>(pos, material_of(pos.board));
+	else
+		return walk_node<depth, V, cr, all_material>(pos);
+}
+
+template <int depth, bool print_move>
+static NodeCount count_root(Position& pos) {
+	return walk_root<depth, std::conditional_t<print_move, DivideLeaves, CountLeaves>>(pos);
+}
+
+// Runtime depth dispatch of a walk, up to max_depth. Each depth instantiates the full generator, so custom walks keep
+// max_depth to what they need. Throws std::invalid_argument for depths out of range.
+template <TreeVisitor V, int max_depth = 6, int depth = 0>
+static NodeCount walk(Position& pos, int d) {
+	if constexpr (depth > max_depth)
+		throw std::invalid_argument("Walk depth " + std::to_string(d) + " out of range");
 	else
-		nodes = pyke::count_moves<false, depth, true, make_cr_flag(1, 1, 1, 1)>(pos);
+		return d == depth ? walk_root<depth, V>(pos) : walk<V, max_depth, depth + 1>(pos, d);
+}
+
+// Runtime depth dispatch of the root call, compiled once in perft.cpp. Prints the divide output if print_move is set.
+NodeCount count_root(Position& pos, int depth, bool print_move = false);
 
+// Prints hardware counter rates as well when PYKE_COUNTERS=1.
+static uint64_t perft(Position& pos, int depth) {
+	std::unique_ptr<CounterSet> counters = counters_requested() ? std::make_unique<CounterSet>() : nullptr;
+	if (counters) counters->start();
+	clock_t start = clock();
+	uint64_t nodes = count_root(pos, depth, true);
 	clock_t end = clock();
+	CounterValues counted = counters ? counters->stop() : CounterValues();
+
 	double time_cost = double(end - start) / CLOCKS_PER_SEC;
 	std::cout << "PERFT results: \nNodes evaluated: " << nodes << "\nTime cost: " << time_cost << '\n';
 	std::cout << std::round((nodes / 1000000)) / time_cost << " million nodes per second" << '\n';
+	if (counters) print_counters(std::cout, counted, nodes, time_cost);
 	std::cout << "================================================================================ \n";
 	return nodes;
 }
 
-static uint64_t perft(Position& pos, int depth) {
-	switch (depth) {
-	case 0:
-		return 1;
-	case 1:
-		return perft_internal<1>(pos);
-	case 2:
-		return perft_internal<2>(pos);
-	case 3:
-		return perft_internal<3>(pos);
-	case 4:
-		return perft_internal<4>(pos);
-	case 5:
-		return perft_internal<5>(pos);
-	case 6:
-		return perft_internal<6>(pos);
-	case 7:
-		return perft_internal<7>(pos);
-	case 8:
-		return perft_internal<8>(pos);
-	case 9:
-		return perft_internal<9>(pos);
-	case 10:
-		return perft_internal<10>(pos);
-	default:
-		std::cout << "Depth above 10 not supported." << std::endl;
-		return 0;
-	}
-}
+#endif
@@ -0,0 +1,223 @@
+#include "perft_cache.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+
+#include "movegen.hpp"
+
+static constexpr char cache_magic[8] = "PYKEPC1";
+static constexpr size_t cache_header_size = 64;
+
+uint32_t PerftCacheEntry::checksum() const {
+	uint64_t h = pos.hash() ^ (uint64_t(depth) * 0x9E3779B97F4A7C15ULL) ^ (nodes * 0xBF58476D1CE4E5B9ULL);
+	h ^= h >> 32;
+	// Never 0, so zeroed space never passes.
+	return uint32_t(h) | 1;
+}
+
+static uint64_t key_hash(const PackedPosition& pos, int depth) { return pos.hash() ^ (uint64_t(depth) << 56); }
+
+static std::runtime_error io_error(const std::string& what, const std::string& path) {
+	return std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+static void write_all(int fd, const void* data, size_t bytes, const std::string& path) {
+	const char* p = static_cast<const char*>(data);
+	while (bytes) {
+		ssize_t n = write(fd, p, bytes);
+		if (n < 0) throw io_error("Can not write", path);
+		p += n;
+		bytes -= n;
+	}
+}
+
+static void write_header(int fd, const std::string& path) {
+	char header[cache_header_size] = {};
+	std::memcpy(header, cache_magic, sizeof(cache_magic));
+	uint32_t entry_size = sizeof(PerftCacheEntry);
+	std::memcpy(header + 8, &entry_size, sizeof(entry_size));
+	write_all(fd, header, cache_header_size, path);
+}
+
+PerftCache::PerftCache(const std::string& path, size_t max_bytes) : path(path), max_bytes(max_bytes) {
+	fd = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+	if (fd < 0) throw io_error("Can not open", path);
+	try {
+		struct stat st;
+		if (fstat(fd, &st)) throw io_error("Can not stat", path);
+		size_t size = st.st_size;
+
+		char header[cache_header_size];
+		if (size == 0) {
+			write_header(fd, path);
+			size = cache_header_size;
+		} else if (size < cache_header_size || pread(fd, header, cache_header_size, 0) != cache_header_size
+				   || std::memcmp(header, cache_magic, sizeof(cache_magic))) {
+			throw std::runtime_error(path + " is not a perft cache file");
+		}
+
+		size_t count = (size - cache_header_size) / sizeof(PerftCacheEntry);
+		if (count) {
+			void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+			if (p == MAP_FAILED) throw io_error("Can not map", path);
+			mapped_bytes = size;
+			mapped = reinterpret_cast<const PerftCacheEntry*>(static_cast<const char*>(p) + cache_header_size);
+		}
+		// Entries from the first invalid one on are the tail of an interrupted write.
+		while (mapped_count < count && mapped[mapped_count].valid()) mapped_count++;
+		size_t valid_size = cache_header_size + mapped_count * sizeof(PerftCacheEntry);
+		if (valid_size != size && ftruncate(fd, valid_size)) throw io_error("Can not truncate", path);
+	} catch (...) {
+		release();
+		throw;
+	}
+
+	index.assign(std::max<size_t>(1024, std::bit_ceil(mapped_count * 2 + 1)), 0);
+	for (uint32_t n = 0; n < mapped_count; n++) insert_index(n);
+}
+
+PerftCache::~PerftCache() { release(); }
+
+void PerftCache::release() {
+	if (mapped) munmap(const_cast<char*>(reinterpret_cast<const char*>(mapped)) - cache_header_size, mapped_bytes);
+	mapped = nullptr;
+	if (fd >= 0) {
+		fsync(fd);
+		close(fd);
+	}
+	fd = -1;
+}
+
+size_t PerftCache::file_bytes() const {
+	return cache_header_size + (mapped_count + appended.size()) * sizeof(PerftCacheEntry);
+}
+
+const PerftCacheEntry& PerftCache::entry(uint32_t number) const {
+	return number < mapped_count ? mapped[number] : appended[number - mapped_count];
+}
+
+void PerftCache::insert_index(uint32_t number) {
+	if ((index_count + 1) * 2 > index.size()) {
+		std::vector<uint32_t> old(index.size() * 2, 0);
+		old.swap(index);
+		index_count = 0;
+		for (uint32_t slot : old)
+			if (slot) insert_index(slot - 1);
+	}
+	const PerftCacheEntry& e = entry(number);
+	size_t mask = index.size() - 1;
+	for (size_t i = key_hash(e.pos, e.depth) & mask;; i = (i + 1) & mask) {
+		if (!index[i]) {
+			index[i] = number + 1;
+			index_count++;
+			return;
+		}
+		const PerftCacheEntry& other = entry(index[i] - 1);
+		if (other.depth == e.depth && other.pos == e.pos) {
+			index[i] = number + 1;
+			return;
+		}
+	}
+}
+
+bool PerftCache::lookup(const PackedPosition& pos, int depth, NodeCount& nodes) {
+	size_t mask = index.size() - 1;
+	for (size_t i = key_hash(pos, depth) & mask; index[i]; i = (i + 1) & mask) {
+		const PerftCacheEntry& e = entry(index[i] - 1);
+		if (e.depth == uint32_t(depth) && e.pos == pos) {
+			nodes = e.nodes;
+			counters.hits++;
+			return true;
+		}
+	}
+	counters.misses++;
+	return false;
+}
+
+void PerftCache::store(const PackedPosition& pos, int depth, NodeCount nodes) {
+	if (file_bytes() + sizeof(PerftCacheEntry) > max_bytes) {
+		counters.dropped++;
+		return;
+	}
+	PerftCacheEntry e{pos, uint32_t(depth), 0, nodes};
+	e.check = e.checksum();
+	// One write per entry, so a crash in the middle leaves an entry that fails its checksum.
+	if (write(fd, &e, sizeof(e)) != sizeof(e)) {
+		counters.dropped++;
+		return;
+	}
+	appended.push_back(e);
+	insert_index(mapped_count + appended.size() - 1);
+	counters.stored++;
+}
+
+NodeCount PerftCache::count(Position& pos, int depth) { return count(pos, depth, 0); }
+
+NodeCount PerftCache::count(Position& pos, int depth, int ply) {
+	if (depth < min_depth) return count_root(pos, depth);
+	PackedPosition key = pack_position(pos);
+	NodeCount nodes = 0;
+	if (lookup(key, depth, nodes)) return nodes;
+	if (ply >= plies) {
+		nodes = count_root(pos, depth);
+	} else {
+		MoveBuffer moves;
+		pyke::generate_legal_moves(pos, moves);
+		for (Move m : moves) {
+			MoveUndo undo = pyke::make_move(pos, m);
+			nodes += count(pos, depth - 1, ply + 1);
+			pyke::unmake_move(pos, m, undo);
+		}
+	}
+	store(key, depth, nodes);
+	return nodes;
+}
+
+std::vector<PerftCacheEntry> PerftCache::entries() const {
+	std::vector<PerftCacheEntry> ret(mapped, mapped + mapped_count);
+	ret.insert(ret.end(), appended.begin(), appended.end());
+	return ret;
+}
+
+size_t PerftCache::compact(const std::string& path, const std::string& out, size_t max_bytes) {
+	std::vector<PerftCacheEntry> all;
+	{
+		PerftCache cache(path);
+		all = cache.entries();
+	}
+	// The last entry of a key wins, as in the index.
+	std::map<std::pair<PackedPosition, uint32_t>, size_t> latest;
+	for (size_t i = 0; i < all.size(); i++) latest[{all[i].pos, all[i].depth}] = i;
+	std::vector<PerftCacheEntry> kept;
+	for (const auto& [key, i] : latest) kept.push_back(all[i]);
+	std::stable_sort(kept.begin(), kept.end(),
+					 [](const PerftCacheEntry& a, const PerftCacheEntry& b) { return a.depth > b.depth; });
+	size_t fit = max_bytes > cache_header_size ? (max_bytes - cache_header_size) / sizeof(PerftCacheEntry) : 0;
+	kept.resize(std::min(kept.size(), fit));
+
+	// Written beside the target and renamed over it, so a crash leaves either the old or the new file.
+	std::string tmp = out + ".tmp";
+	int tmp_fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (tmp_fd < 0) throw io_error("Can not open", tmp);
+	try {
+		write_header(tmp_fd, tmp);
+		write_all(tmp_fd, kept.data(), kept.size() * sizeof(PerftCacheEntry), tmp);
+		if (fsync(tmp_fd)) throw io_error("Can not sync", tmp);
+	} catch (...) {
+		close(tmp_fd);
+		throw;
+	}
+	close(tmp_fd);
+	if (std::rename(tmp.c_str(), out.c_str())) throw io_error("Can not rename", out);
+	return kept.size();
+}
@@ -0,0 +1,87 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "packed_position.hpp"
+#include "perft.hpp"
+
+#ifndef PERFT_CACHE_H
+#define PERFT_CACHE_H
+
+// Perft counts kept in a file across runs, keyed by the packed position and the depth. The file is a 64 byte header
+// and a log of 48 byte entries that only grows at the end. Each entry carries a checksum, so an entry torn by a crash
+// fails it and is cut off when the file is opened again. The log is mapped, and an index in memory points into it.
+// Once the file reaches its size limit, new counts are not stored. perft_cache compact rewrites a file with one entry
+// per key, the deepest first when it has to drop some to fit a limit.
+
+struct PerftCacheEntry {
+	PackedPosition pos;
+	uint32_t depth;
+	uint32_t check;
+	NodeCount nodes;
+
+	uint32_t checksum() const;
+	bool valid() const { return check == checksum(); }
+};
+
+static_assert(sizeof(PerftCacheEntry) == 48);
+
+struct PerftCacheStats {
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t stored = 0;
+	// Entries not stored because the file was full.
+	uint64_t dropped = 0;
+};
+
+struct PerftCache {
+	// Opens or creates the file. Throws std::runtime_error if it can not be opened or is not a cache file.
+	explicit PerftCache(const std::string& path, size_t max_bytes = size_t(1) << 30);
+	~PerftCache();
+	PerftCache(const PerftCache&) = delete;
+	PerftCache& operator=(const PerftCache&) = delete;
+
+	// Subtrees shallower than this are counted, not looked up.
+	int min_depth = 3;
+	// Plies below the root that are looked up; the rest of the tree is counted with count_root.
+	int plies = 3;
+
+	bool lookup(const PackedPosition& pos, int depth, NodeCount& nodes);
+	void store(const PackedPosition& pos, int depth, NodeCount nodes);
+
+	// Perft of pos through the cache: the first plies look up and store every subtree.
+	NodeCount count(Position& pos, int depth);
+
+	size_t size() const { return index_count; }
+	size_t file_bytes() const;
+	const PerftCacheStats& stats() const { return counters; }
+
+	// Every entry, in file order.
+	std::vector<PerftCacheEntry> entries() const;
+
+	// Writes the entries of path to out, one per key, dropping the shallowest beyond max_bytes. Returns the entries
+	// kept. Throws std::runtime_error on I/O errors.
+	static size_t compact(const std::string& path, const std::string& out, size_t max_bytes);
+
+private:
+	std::string path;
+	size_t max_bytes;
+	int fd = -1;
+	const PerftCacheEntry* mapped = nullptr;
+	size_t mapped_bytes = 0;
+	size_t mapped_count = 0;
+	// Entries appended since the file was mapped.
+	std::vector<PerftCacheEntry> appended;
+	// Open addressing over entry numbers + 1, 0 for empty slots.
+	std::vector<uint32_t> index;
+	size_t index_count = 0;
+	PerftCacheStats counters;
+
+	const PerftCacheEntry& entry(uint32_t number) const;
+	void insert_index(uint32_t number);
+	void release();
+	NodeCount count(Position& pos, int depth, int ply);
+};
+
+#endif
@@ -0,0 +1,56 @@
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+#include "perft_cache.hpp"
+
+// Maintenance of perft cache files:
+//
+//   perft_cache_tool stats FILE
+//   perft_cache_tool compact FILE [--out FILE] [--max-mb N]
+//
+// stats prints the entries by depth. compact rewrites the file with one entry per key, keeping the deepest entries
+// that fit in --max-mb, in place unless --out is given.
+
+static int usage() {
+	std::cout << "Usage: perft_cache_tool stats FILE\n"
+				 "       perft_cache_tool compact FILE [--out FILE] [--max-mb N]\n";
+	return 1;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 3) return usage();
+	std::string cmd = argv[1], path = argv[2], out = path;
+	size_t max_mb = 1024;
+	for (int i = 3; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--out" && i + 1 < argc)
+			out = argv[++i];
+		else if (arg == "--max-mb" && i + 1 < argc)
+			max_mb = std::stoull(argv[++i]);
+		else
+			return usage();
+	}
+
+	try {
+		if (cmd == "stats") {
+			PerftCache cache(path);
+			std::map<uint32_t, size_t> by_depth;
+			for (const PerftCacheEntry& e : cache.entries()) by_depth[e.depth]++;
+			std::cout << path << ": " << cache.size() << " keys, " << cache.file_bytes() << " bytes\n";
+			for (const auto& [depth, entries] : by_depth) std::cout << "depth " << depth << ": " << entries << '\n';
+		} else if (cmd == "compact") {
+			size_t before = PerftCache(path).entries().size();
+			size_t kept = PerftCache::compact(path, out, max_mb << 20);
+			std::cout << "Kept " << kept << " of " << before << " entries in " << out << '\n';
+		} else {
+			return usage();
+		}
+	} catch (const std::runtime_error& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+	return 0;
+}
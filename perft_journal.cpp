@@ -0,0 +1,109 @@
+#include "perft_journal.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+static constexpr const char* journal_magic = "pyke-perft-journal";
+static constexpr int journal_version = 1;
+
+std::string path_string(const MovePath& path) {
+	std::string ret;
+	for (const Move& m : path) ret += (ret.empty() ? "" : " ") + m.to_string();
+	return ret;
+}
+
+std::vector<bool> parse_unit_list(const std::string& list, size_t count) {
+	std::vector<bool> selected(count);
+	std::stringstream ss(list);
+	std::string range;
+	while (std::getline(ss, range, ',')) {
+		size_t dash = range.find('-');
+		size_t first, last;
+		try {
+			first = std::stoull(range.substr(0, dash));
+			last = dash == std::string::npos ? first : std::stoull(range.substr(dash + 1));
+		} catch (const std::logic_error&) {
+			throw std::invalid_argument("Malformed unit list: " + list);
+		}
+		if (first > last || last >= count)
+			throw std::invalid_argument("Units " + range + " out of range, there are " + std::to_string(count));
+		for (size_t u = first; u <= last; u++) selected[u] = true;
+	}
+	return selected;
+}
+
+static void write_all(int fd, const std::string& text, const std::string& path) {
+	const char* p = text.data();
+	size_t left = text.size();
+	while (left) {
+		ssize_t n = write(fd, p, left);
+		if (n < 0) throw std::runtime_error("Can not write " + path + ": " + std::strerror(errno));
+		p += n;
+		left -= n;
+	}
+	if (fsync(fd)) throw std::runtime_error("Can not sync " + path + ": " + std::strerror(errno));
+}
+
+PerftJournal::PerftJournal(const std::string& path, const std::string& fen, int depth, int unit_ply,
+						   const std::vector<MovePath>& units)
+	: path(path), units(units) {
+	std::ostringstream header;
+	header << journal_magic << ' ' << journal_version << ' ' << depth << ' ' << unit_ply << ' ' << units.size() << ' '
+		   << fen;
+
+	// Complete lines only; a crash can leave the last one cut short.
+	std::ifstream in(path, std::ios::binary);
+	std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	size_t complete = text.rfind('\n');
+	complete = complete == std::string::npos ? 0 : complete + 1;
+
+	std::istringstream lines(text.substr(0, complete));
+	std::string line;
+	if (std::getline(lines, line) && line != header.str())
+		throw std::runtime_error(path + " is the journal of another run: " + line);
+	for (size_t number = 2; std::getline(lines, line); number++) {
+		// Headers of concatenated shard journals.
+		if (line == header.str()) continue;
+		std::istringstream fields(line);
+		size_t unit;
+		NodeCount nodes;
+		std::string moves;
+		if (!(fields >> unit >> nodes) || unit >= units.size())
+			throw std::runtime_error(path + ":" + std::to_string(number) + ": malformed entry");
+		std::getline(fields >> std::ws, moves);
+		if (moves != path_string(units[unit]))
+			throw std::runtime_error(path + ":" + std::to_string(number) + ": unit " + std::to_string(unit) + " is "
+									 + path_string(units[unit]) + ", not " + moves);
+		auto [it, added] = counts.emplace(unit, nodes);
+		if (!added && it->second != nodes)
+			throw std::runtime_error(path + ": conflicting counts for unit " + std::to_string(unit));
+	}
+
+	fd = open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+	if (fd < 0 || ftruncate(fd, complete) || lseek(fd, 0, SEEK_END) < 0)
+		throw std::runtime_error("Can not open " + path + ": " + std::strerror(errno));
+	if (complete == 0) write_all(fd, header.str() + '\n', path);
+}
+
+PerftJournal::~PerftJournal() {
+	if (fd >= 0) close(fd);
+}
+
+bool PerftJournal::known(size_t unit, NodeCount& nodes) const {
+	auto it = counts.find(unit);
+	if (it == counts.end()) return false;
+	nodes = it->second;
+	return true;
+}
+
+void PerftJournal::record(size_t unit, NodeCount nodes) {
+	write_all(fd, std::to_string(unit) + ' ' + std::to_string(nodes) + ' ' + path_string(units[unit]) + '\n', path);
+	counts.emplace(unit, nodes);
+}
@@ -0,0 +1,45 @@
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "perft_progress.hpp"
+
+#ifndef PERFT_JOURNAL_H
+#define PERFT_JOURNAL_H
+
+// Append-only record of the finished work units of a perft run, so a run can stop at any point and pick up where it
+// left off. Work units are the subtrees of perft_divide, numbered in perft_paths order. The first line names the run:
+//
+//   pyke-perft-journal 1 <depth> <unit ply> <units> <fen>
+//
+// and each finished unit adds "<unit> <count> <path>", written with a single write and synced to disk. A line cut
+// short by a crash is dropped when the journal is opened again. Journals of shards of the same run can be
+// concatenated; a unit that shows up twice must have the same count.
+struct PerftJournal {
+	// Opens or creates the journal at path. Throws std::runtime_error if it can not be written, belongs to another
+	// run, or lists a unit whose path is not the one at that index.
+	PerftJournal(const std::string& path, const std::string& fen, int depth, int unit_ply,
+				 const std::vector<MovePath>& units);
+	~PerftJournal();
+	PerftJournal(const PerftJournal&) = delete;
+	PerftJournal& operator=(const PerftJournal&) = delete;
+
+	bool known(size_t unit, NodeCount& nodes) const;
+	void record(size_t unit, NodeCount nodes);
+	size_t size() const { return counts.size(); }
+
+private:
+	std::string path;
+	const std::vector<MovePath>& units;
+	std::map<size_t, NodeCount> counts;
+	int fd = -1;
+};
+
+// Unit lists such as "0-99,250,300-310". Throws std::invalid_argument on malformed lists and units past count.
+std::vector<bool> parse_unit_list(const std::string& list, size_t count);
+
+std::string path_string(const MovePath& path);
+
+#endif
@@ -0,0 +1,114 @@
+#include "perft_progress.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+
+#include "perft_cache.hpp"
+
+static std::atomic<bool> signal_cancel = false;
+
+static void on_cancel_signal(int signal) {
+	signal_cancel = true;
+	std::signal(signal, SIG_DFL);
+}
+
+void cancel_perft_on_signal(int signal) { std::signal(signal, on_cancel_signal); }
+
+static void collect_paths(Position& pos, int ply, MovePath& path, std::vector<MovePath>& out) {
+	if (ply == 0) {
+		out.push_back(path);
+		return;
+	}
+	MoveBuffer moves;
+	pyke::generate_legal_moves(pos, moves);
+	for (Move m : moves) {
+		MoveUndo undo = pyke::make_move(pos, m);
+		path.push_back(m);
+		collect_paths(pos, ply - 1, path, out);
+		path.pop_back();
+		pyke::unmake_move(pos, m, undo);
+	}
+}
+
+std::vector<MovePath> perft_paths(Position& pos, int ply) {
+	std::vector<MovePath> paths;
+	MovePath path;
+	collect_paths(pos, ply, path, paths);
+	return paths;
+}
+
+NodeCount count_path(Position& pos, const MovePath& path, int depth, PerftCache* cache) {
+	std::vector<MoveUndo> undo(path.size());
+	for (size_t i = 0; i < path.size(); i++) undo[i] = pyke::make_move(pos, path[i]);
+	int left = depth - int(path.size());
+	NodeCount nodes = cache ? cache->count(pos, left) : count_root(pos, left);
+	for (size_t i = path.size(); i-- > 0;) pyke::unmake_move(pos, path[i], undo[i]);
+	return nodes;
+}
+
+PerftResult perft_divide(Position& pos, int depth, PerftControl& control) {
+	using clock = std::chrono::steady_clock;
+	PerftResult result;
+	auto start = clock::now();
+	if (depth <= 0) {
+		result.nodes = 1;
+		return result;
+	}
+	signal_cancel = false;
+
+	std::vector<MovePath> paths = perft_paths(pos, std::clamp(control.split_ply, 1, depth));
+	std::vector<bool> selected(paths.size(), true);
+	for (size_t i = 0; control.selected && i < paths.size(); i++) selected[i] = control.selected(i);
+	result.total = std::count(selected.begin(), selected.end(), true);
+
+	auto last_report = start;
+	size_t counted = 0, to_count = result.total;
+	NodeCount counted_nodes = 0;
+	NodeCount root_nodes = 0;
+	bool root_complete = true;
+
+	auto progress = [&](Move root_move, NodeCount root_count) {
+		if (!control.on_progress) return;
+		double seconds = std::chrono::duration<double>(clock::now() - start).count();
+		double eta = counted ? seconds / counted * (to_count - counted) : -1;
+		control.on_progress({result.nodes, result.done, result.total, seconds,
+							 seconds > 0 ? counted_nodes / seconds : 0, eta, root_move, root_count});
+	};
+
+	for (size_t i = 0; i < paths.size(); i++) {
+		NodeCount nodes = 0;
+		if (!selected[i]) {
+			root_complete = false;
+		} else if (control.known && control.known(i, nodes)) {
+			result.done++;
+			to_count--;
+		} else if (control.cancel || signal_cancel) {
+			result.cancelled = true;
+			break;
+		} else {
+			nodes = count_path(pos, paths[i], depth, control.cache);
+			if (control.counted) control.counted(i, nodes);
+			result.done++;
+			counted++;
+			counted_nodes += nodes;
+		}
+		result.nodes += nodes;
+		root_nodes += nodes;
+
+		if (i + 1 == paths.size() || paths[i + 1][0] != paths[i][0]) {
+			if (root_complete) {
+				result.divide.push_back({paths[i][0], root_nodes});
+				progress(paths[i][0], root_nodes);
+				last_report = clock::now();
+			}
+			root_nodes = 0;
+			root_complete = true;
+		} else if (std::chrono::duration<double>(clock::now() - last_report).count() >= control.report_interval) {
+			progress(Move(), 0);
+			last_report = clock::now();
+		}
+	}
+	result.seconds = std::chrono::duration<double>(clock::now() - start).count();
+	return result;
+}
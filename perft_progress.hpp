@@ -0,0 +1,83 @@
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "movegen.hpp"
+#include "perft.hpp"
+
+#ifndef PERFT_PROGRESS_H
+#define PERFT_PROGRESS_H
+
+// Perft for long runs, with progress reports and cooperative cancellation. The tree is split into the subtrees below
+// the moves paths to a shallow ply, and each subtree is counted with count_root. Progress and the cancel flag are only
+// looked at between subtrees, so the counting itself runs at full speed.
+
+struct PerftCache;
+
+// Legal move path from the root to a subtree.
+using MovePath = std::vector<Move>;
+
+struct PerftProgress {
+	// Nodes of the finished subtrees.
+	NodeCount nodes;
+	size_t done;
+	size_t total;
+	double seconds;
+	// Over the subtrees counted in this run.
+	double nps;
+	// Seconds left, from the average time of the subtrees counted in this run; negative until one is counted.
+	double eta;
+	// The root move that has just finished and its count; a null move for interval reports.
+	Move root_move;
+	NodeCount root_nodes;
+};
+
+struct PerftControl {
+	// Ply the tree is split at, clamped to the depth.
+	int split_ply = 2;
+	// Seconds between interval reports. Reports for finished root moves are always sent.
+	double report_interval = 1;
+	std::function<void(const PerftProgress&)> on_progress;
+	// Set from any thread to stop after the running subtree.
+	std::atomic<bool> cancel = false;
+
+	// Optional hooks by subtree index, in perft_paths order. selected leaves subtrees out, e.g. the work units of other
+	// shards. known gives the count of a subtree counted before, which is then not counted again. counted is called
+	// after every subtree this run counts.
+	std::function<bool(size_t)> selected;
+	std::function<bool(size_t, NodeCount&)> known;
+	std::function<void(size_t, NodeCount)> counted;
+
+	// Optional cache the subtrees are looked up in and stored to.
+	PerftCache* cache = nullptr;
+};
+
+struct PerftResult {
+	// Sum over the finished subtrees.
+	NodeCount nodes = 0;
+	// Root moves with every subtree finished.
+	std::vector<std::pair<Move, NodeCount>> divide;
+	size_t done = 0;
+	size_t total = 0;
+	// Set if the run was cancelled; the counts then cover the subtrees finished before.
+	bool cancelled = false;
+	double seconds = 0;
+
+	bool complete() const { return done == total; }
+};
+
+// Paths to every position at the given ply, in move generation order. Paths that end in mate or stalemate earlier
+// lead to no leaves and are left out.
+std::vector<MovePath> perft_paths(Position& pos, int ply);
+
+// Leaves at depth below pos, counted at the end of path, through the cache if there is one. Restores pos.
+NodeCount count_path(Position& pos, const MovePath& path, int depth, PerftCache* cache = nullptr);
+
+PerftResult perft_divide(Position& pos, int depth, PerftControl& control);
+
+// Makes the signal (e.g. SIGINT) cancel running perft_divide calls. A second signal gets the default action.
+void cancel_perft_on_signal(int signal);
+
+#endif
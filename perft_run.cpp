@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "perft_cache.hpp"
+#include "perft_journal.hpp"
+#include "perft_progress.hpp"
+
+// Perft for long runs. Prints the divide count of every root move as it finishes and progress lines with nodes, speed
+// and ETA on stderr. Ctrl-C stops after the running subtree and prints the root moves finished so far.
+//
+// The subtrees below --split plies are numbered work units. With --journal every finished unit is appended to the
+// journal file, and a restarted run skips the units it holds. --units runs a subset, e.g. one shard per machine, and
+// --list prints the units with their move paths.
+//
+// --cache keeps the counts of subtrees near the units in a file, so runs from other positions or to other depths that
+// reach the same subtrees look them up instead of counting them.
+
+const std::string start_fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+static std::string format_duration(double seconds) {
+	if (seconds < 0) return "?";
+	uint64_t s = uint64_t(seconds);
+	char text[32];
+	if (s >= 3600)
+		std::snprintf(text, sizeof(text), "%luh%02lum%02lus", s / 3600, s / 60 % 60, s % 60);
+	else if (s >= 60)
+		std::snprintf(text, sizeof(text), "%lum%02lus", s / 60, s % 60);
+	else
+		std::snprintf(text, sizeof(text), "%.1fs", seconds);
+	return text;
+}
+
+int main(int argc, char* argv[]) {
+	std::string fen = start_fen;
+	int depth = 6;
+	bool quiet = false;
+	bool list = false;
+	std::string journal_path, unit_list, cache_path;
+	size_t cache_mb = 1024;
+	PerftControl control;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--depth" && i + 1 < argc) {
+			depth = std::stoi(argv[++i]);
+		} else if (arg == "--fen" && i + 1 < argc) {
+			fen = argv[++i];
+		} else if (arg == "--split" && i + 1 < argc) {
+			control.split_ply = std::stoi(argv[++i]);
+		} else if (arg == "--interval" && i + 1 < argc) {
+			control.report_interval = std::stod(argv[++i]);
+		} else if (arg == "--journal" && i + 1 < argc) {
+			journal_path = argv[++i];
+		} else if (arg == "--units" && i + 1 < argc) {
+			unit_list = argv[++i];
+		} else if (arg == "--cache" && i + 1 < argc) {
+			cache_path = argv[++i];
+		} else if (arg == "--cache-mb" && i + 1 < argc) {
+			cache_mb = std::stoull(argv[++i]);
+		} else if (arg == "--list") {
+			list = true;
+		} else if (arg == "--quiet") {
+			quiet = true;
+		} else {
+			std::cout << "Usage: perft_run [--depth N] [--fen FEN] [--split PLY] [--interval SECONDS] [--journal FILE] "
+						 "[--units LIST] [--list] [--cache FILE] [--cache-mb N] [--quiet]\n";
+			return 1;
+		}
+	}
+
+	Position pos;
+	std::vector<MovePath> units;
+	std::vector<bool> selected;
+	std::unique_ptr<PerftJournal> journal;
+	std::unique_ptr<PerftCache> cache;
+	try {
+		pos.load_fen(fen);
+		if (depth > 0) units = perft_paths(pos, std::clamp(control.split_ply, 1, depth));
+		if (!unit_list.empty()) selected = parse_unit_list(unit_list, units.size());
+		if (!journal_path.empty())
+			journal = std::make_unique<PerftJournal>(journal_path, fen, depth, control.split_ply, units);
+		if (!cache_path.empty()) cache = std::make_unique<PerftCache>(cache_path, cache_mb << 20);
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+
+	if (list) {
+		for (size_t u = 0; u < units.size(); u++) {
+			NodeCount nodes;
+			std::cout << u << ' ' << path_string(units[u]);
+			if (journal && journal->known(u, nodes)) std::cout << " (done, " << nodes << ')';
+			std::cout << '\n';
+		}
+		return 0;
+	}
+	if (!selected.empty()) control.selected = [&](size_t u) { return bool(selected[u]); };
+	if (journal) {
+		control.known = [&](size_t u, NodeCount& nodes) { return journal->known(u, nodes); };
+		control.counted = [&](size_t u, NodeCount nodes) { journal->record(u, nodes); };
+		if (journal->size())
+			std::cerr << "resuming: " << journal->size() << " of " << units.size() << " units in the journal"
+					  << std::endl;
+	}
+
+	control.on_progress = [&](const PerftProgress& p) {
+		if (!p.root_move.is_null()) std::cout << p.root_move.to_string() << ": " << p.root_nodes << std::endl;
+		if (quiet) return;
+		std::cerr << "progress: " << p.done << "/" << p.total << " subtrees, " << p.nodes << " nodes, "
+				  << uint64_t(p.nps / 1e6) << " MNPS, " << format_duration(p.seconds) << " elapsed, eta "
+				  << format_duration(p.eta) << std::endl;
+	};
+	control.cache = cache.get();
+	bool resumed = journal && journal->size();
+	cancel_perft_on_signal(SIGINT);
+	PerftResult result;
+	try {
+		result = perft_divide(pos, depth, control);
+	} catch (const std::runtime_error& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+
+	std::cout << "\nNodes searched: " << result.nodes << '\n';
+	std::cout << "Time: " << format_duration(result.seconds);
+	// A resumed or cached run did not count all of its nodes.
+	if (!resumed && !cache && result.seconds > 0)
+		std::cout << ", " << uint64_t(result.nodes / result.seconds / 1e6) << " MNPS";
+	std::cout << std::endl;
+	if (cache) {
+		const PerftCacheStats& s = cache->stats();
+		std::cout << "Cache: " << s.hits << " hits, " << s.misses << " misses, " << s.stored << " stored, " << s.dropped
+				  << " dropped, " << cache->size() << " entries, " << (cache->file_bytes() >> 20) << " MB" << std::endl;
+	}
+	if (!selected.empty() && result.complete())
+		std::cout << "Selection of " << result.total << " of " << units.size() << " units is counted." << std::endl;
+	if (!result.complete()) {
+		std::cout << (result.cancelled ? "Cancelled" : "Partial") << ": " << result.done << " of " << result.total
+				  << " units" << (selected.empty() ? "" : " of the selection")
+				  << " are counted, the node count and divide cover only those." << std::endl;
+	}
+	return result.cancelled ? 130 : 0;
+}
@@ -0,0 +1,52 @@
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "walks.hpp"
+
+// Perft table with the leaves in check, the checkmates and the unique positions at every depth, from custom walks
+// over the same generator as count_root.
+
+const std::string start_fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+constexpr int max_depth = 5;
+
+int main(int argc, char* argv[]) {
+	std::string fen = start_fen;
+	int depth = 4;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--depth" && i + 1 < argc) {
+			depth = std::stoi(argv[++i]);
+		} else if (arg == "--fen" && i + 1 < argc) {
+			fen = argv[++i];
+		} else {
+			std::cout << "Usage: perft_stats [--depth N] [--fen FEN]\n";
+			return 1;
+		}
+	}
+
+	Position pos;
+	try {
+		pos.load_fen(fen);
+		if (depth < 1 || depth > max_depth)
+			throw std::invalid_argument("Depth must be between 1 and " + std::to_string(max_depth));
+	} catch (const std::invalid_argument& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+
+	std::cout << std::setw(6) << "depth" << std::setw(14) << "nodes" << std::setw(12) << "checks" << std::setw(12)
+			  << "mates" << std::setw(14) << "positions" << '\n';
+	for (int d = 1; d <= depth; d++) {
+		std::vector<PackedPosition> leaves = collect_leaves<AnyLeaf, max_depth>(pos, d);
+		std::sort(leaves.begin(), leaves.end());
+		size_t unique = std::unique(leaves.begin(), leaves.end()) - leaves.begin();
+		std::cout << std::setw(6) << d << std::setw(14) << walk<CountLeaves, max_depth>(pos, d) << std::setw(12)
+				  << walk<CountIf<InCheck>, max_depth>(pos, d) << std::setw(12)
+				  << walk<CountIf<Checkmate>, max_depth>(pos, d) << std::setw(14) << unique << '\n';
+	}
+	return 0;
+}
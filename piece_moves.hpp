@@ -1,5 +1,7 @@
 #include <immintrin.h>
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
 
 #include "board.hpp"
@@ -15,12 +17,25 @@ static inline BitBoard get_knight_move(const Square square) { return KNIGHT_MOVE
 
 // Bishop moving logic.
 static inline BitBoard get_bishop_move(const Square square, const BitBoard occ) {
-	return bishop_pext_atk[bishop_pext_offset[square] + static_cast<uint32_t>(pext(occ, bishop_mask_table[square]))];
+	uint32_t idx = bishop_pext_offset[square] + static_cast<uint32_t>(pext(occ, bishop_mask_table[square]));
+	return thread_lookup_tables->bishop_pext_atk[idx];
 }
 
 // Rook move logic.
 static inline BitBoard get_rook_move(const Square square, const BitBoard occ) {
-	return rook_pext_atk[rook_pext_offset[square] + static_cast<uint32_t>(pext(occ, rook_mask_table[square]))];
+	uint32_t idx = rook_pext_offset[square] + static_cast<uint32_t>(pext(occ, rook_mask_table[square]));
+	return thread_lookup_tables->rook_pext_atk[idx];
+}
+
+// Prefetches the entries get_bishop_move and get_rook_move read for the same arguments.
+static inline void prefetch_bishop_move(const Square square, const BitBoard occ) {
+	uint32_t idx = bishop_pext_offset[square] + static_cast<uint32_t>(pext(occ, bishop_mask_table[square]));
+	__builtin_prefetch(&thread_lookup_tables->bishop_pext_atk[idx]);
+}
+
+static inline void prefetch_rook_move(const Square square, const BitBoard occ) {
+	uint32_t idx = rook_pext_offset[square] + static_cast<uint32_t>(pext(occ, rook_mask_table[square]));
+	__builtin_prefetch(&thread_lookup_tables->rook_pext_atk[idx]);
 }
 
 // Queen move logic.
@@ -143,6 +158,12 @@ static inline BitBoard make_reach_board(Square square, Board& b) {
 	}
 }
 
-const static std::array<std::array<uint64_t, 64>, 64> between_squares = create_betweens();
+// Lives in lookup_tables next to the attack tables.
+inline constexpr auto& between_squares = lookup_tables.between_squares;
+inline const bool between_squares_filled = [] {
+	std::array<std::array<uint64_t, 64>, 64> betweens = create_betweens();
+	std::copy(betweens.begin(), betweens.end(), lookup_tables.between_squares);
+	return true;
+}();
 
 #endif
@@ -0,0 +1,265 @@
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "maskset.hpp"
+#include "movegen.hpp"
+#include "position.hpp"
+#include "pyke.hpp"
+#include "thread_pool.hpp"
+
+#ifndef PLAYOUT_H
+#define PLAYOUT_H
+
+// Target squares of one piece, or of one special move. Promotions weigh four moves per target square.
+struct TargetGroup {
+	BitBoard targets;
+	Square from;
+	Piece piece;
+	MoveType type;
+	uint32_t weight;
+};
+
+// Legal moves of a position as one target set per piece, counted with popcounts instead of being listed.
+struct MoveChoices {
+	// 16 pieces, castling and two ep captures.
+	TargetGroup groups[20];
+	int count = 0;
+	uint32_t total = 0;
+
+	inline void add(BitBoard targets, Square from, Piece piece, MoveType type) {
+		if (!targets) return;
+		uint32_t weight = popcnt(targets) * (type == MOVE_PROMOTION ? 4 : 1);
+		groups[count++] = {targets, from, piece, type, weight};
+		total += weight;
+	}
+};
+
+struct PlayoutStats {
+	uint64_t playouts = 0;
+	uint64_t plies = 0;
+	uint64_t white_wins = 0;
+	uint64_t black_wins = 0;
+	uint64_t draws = 0;
+
+	PlayoutStats& operator+=(const PlayoutStats& other) {
+		playouts += other.playouts;
+		plies += other.plies;
+		white_wins += other.white_wins;
+		black_wins += other.black_wins;
+		draws += other.draws;
+		return *this;
+	}
+};
+
+namespace pyke {
+
+// Reach of a piece from a square, by runtime piece type.
+template <bool white>
+static inline BitBoard piece_reach(Piece p, Square from, Board& b) {
+	switch (p) {
+	case KNIGHT:
+		return get_knight_move(from);
+	case BISHOP:
+		return get_bishop_move(from, b.occ_board);
+	case ROOK:
+		return get_rook_move(from, b.occ_board);
+	case QUEEN:
+		return get_queen_move(from, b.occ_board);
+	default: {
+		BitBoard from_mask = square_to_mask(from);
+		BitBoard reach = (get_pawn_move<white, PawnMoveType::ATTACKS>(from, b.occ_board) & b.occ_board)
+			| (get_pawn_forward<white>(from_mask) & ~b.occ_board);
+		if (from_mask & (white ? pawn_start_w : pawn_start_b)) reach |= get_pawn_double<white>(from_mask, b.occ_board);
+		return reach;
+	}
+	}
+}
+
+// Collects the legal target sets of the side to move. The masks are the ones of count_moves; a pinned piece only
+// keeps the reach along its own pin direction.
+template <bool white>
+void collect_choices(Position& pos, MoveChoices& out) {
+	out.count = 0;
+	out.total = 0;
+	Board& b = pos.board;
+	Square ksq = pos.get_ksq<white>();
+	MaskSet msk;
+	create_masks<white>(b, ksq, msk);
+
+	// King steps with the king lifted from the occupancy.
+	BitBoard king_to = get_king_move(ksq) & msk.cmt;
+	BitBoard safe = 0;
+	b.occ_board ^= square_to_mask(ksq);
+	while (king_to) {
+		Square to = pop(king_to);
+		if (!pos.is_attacked<white>(to)) safe |= square_to_mask(to);
+	}
+	b.occ_board ^= square_to_mask(ksq);
+	out.add(safe, ksq, KING, MOVE_NORMAL);
+
+	switch (msk.checkers) {
+	case 0: {
+		BitBoard castles = 0;
+		for (bool kingside : {true, false}) {
+			uint8_t code = white ? (kingside ? 0 : 1) : (kingside ? 2 : 3);
+			CastlingRights right = white ? (kingside ? wk_mask : wq_mask) : (kingside ? bk_mask : bq_mask);
+			if (!(pos.castling_rights & right)) continue;
+			if (b.square_occ(king_end_squares[code]) || b.square_occ(rook_end_squares[code])) continue;
+			if (!kingside && b.square_occ(queenside_middle_squares[white])) continue;
+			if (pos.is_attacked<white>(rook_end_squares[code]) || pos.is_attacked<white>(king_end_squares[code])) continue;
+			castles |= square_to_mask(king_end_squares[code]);
+		}
+		out.add(castles, ksq, KING, MOVE_CASTLE);
+		break;
+	}
+	case 1:
+		msk.cmt &= msk.check_mask;
+		break;
+	default:
+		return;
+	}
+
+	BitBoard pieces = b.get_player_occ<white>() & ~square_to_mask(ksq);
+	BitBoard promotion_from = white ? promotion_from_w : promotion_from_b;
+	while (pieces) {
+		Square from = pop(pieces);
+		BitBoard from_mask = square_to_mask(from);
+		Piece p = b.get_piece<white>(from);
+		BitBoard targets;
+		if (from_mask & msk.pinmask_dg) {
+			targets = p == PAWN ? piece_reach<white>(PAWN, from, b)
+				: (p == BISHOP || p == QUEEN) ? get_bishop_move(from, b.occ_board)
+											  : 0;
+			targets &= msk.cmt & msk.pinmask_dg;
+		} else if (from_mask & msk.pinmask_orth) {
+			targets = p == PAWN ? piece_reach<white>(PAWN, from, b)
+				: (p == ROOK || p == QUEEN) ? get_rook_move(from, b.occ_board)
+											: 0;
+			targets &= msk.cmt & msk.pinmask_orth;
+		} else {
+			targets = piece_reach<white>(p, from, b) & msk.cmt;
+		}
+		out.add(targets, from, p, p == PAWN && (from_mask & promotion_from) ? MOVE_PROMOTION : MOVE_NORMAL);
+	}
+
+	// Each ep capture is a group of its own, as both can land on the same square.
+	uint8_t ep = pos.ep_flag;
+	if (ep & 0x80 && has_ep_move<white, -1>(pos, ep)) {
+		sq_pair epsq = get_ep_squares<white, -1>(ep);
+		out.add(square_to_mask(epsq.second), epsq.first, PAWN, MOVE_EP);
+	}
+	if (ep & 0x40 && has_ep_move<white, 1>(pos, ep)) {
+		sq_pair epsq = get_ep_squares<white, 1>(ep);
+		out.add(square_to_mask(epsq.second), epsq.first, PAWN, MOVE_EP);
+	}
+}
+
+// Returns move number index, in [0, choices.total), of the collected target sets.
+template <bool white>
+static inline Move choose_move(Position& pos, const MoveChoices& choices, uint32_t index) {
+	const TargetGroup* g = choices.groups;
+	while (index >= g->weight) index -= g++->weight;
+
+	Piece promotion = EMPTY;
+	if (g->type == MOVE_PROMOTION) {
+		promotion = promotion_pieces[index % 4];
+		index /= 4;
+	}
+	Square to = lbit(_pdep_u64(1ULL << index, g->targets));
+	switch (g->type) {
+	case MOVE_CASTLE:
+		return Move(MOVE_CASTLE, KING, g->from, to);
+	case MOVE_EP:
+		return Move(MOVE_EP, PAWN, g->from, to, PAWN);
+	default: {
+		MoveType type = g->type;
+		if (g->piece == PAWN && (to == g->from + 16 || g->from == to + 16)) type = MOVE_DOUBLE;
+		return Move(type, g->piece, g->from, to, pos.board.get_piece<!white>(to), promotion);
+	}
+	}
+}
+
+// Whether neither side can mate: kings with at most one minor piece left.
+static inline bool insufficient_material(Board& b) {
+	if (b.w_pawn | b.b_pawn | b.w_rook | b.b_rook | b.w_queen | b.b_queen) return false;
+	return popcnt(b.w_bishop | b.b_bishop | b.w_knight | b.b_knight) <= 1;
+}
+
+// Plays uniformly random legal moves until the game ends and adds the outcome to stats. Games are drawn by the
+// 50 move rule, insufficient material or the ply limit; repetitions are not tracked.
+template <typename Rng>
+static inline void playout(Position pos, Rng& rng, int max_plies, PlayoutStats& stats) {
+	MoveChoices choices;
+	int halfmove = 0;
+	int ply = 0;
+	stats.playouts++;
+	for (; ply < max_plies; ply++) {
+		bool white = pos.white_turn;
+		if (white)
+			collect_choices<true>(pos, choices);
+		else
+			collect_choices<false>(pos, choices);
+
+		if (!choices.total) {
+			bool in_check = white ? pos.is_attacked<true>(pos.wksq) : pos.is_attacked<false>(pos.bksq);
+			if (!in_check)
+				stats.draws++;
+			else if (white)
+				stats.black_wins++;
+			else
+				stats.white_wins++;
+			stats.plies += ply;
+			return;
+		}
+
+		uint32_t index = (uint64_t(uint32_t(rng())) * choices.total) >> 32;
+		Move m = white ? choose_move<true>(pos, choices, index) : choose_move<false>(pos, choices, index);
+		if (white)
+			make_move<true>(pos, m);
+		else
+			make_move<false>(pos, m);
+
+		bool capture = m.get_captured() != EMPTY;
+		halfmove = m.get_piece() == PAWN || capture ? 0 : halfmove + 1;
+		if (halfmove >= 100 || (capture && insufficient_material(pos.board))) {
+			ply++;
+			break;
+		}
+	}
+	stats.draws++;
+	stats.plies += ply;
+}
+
+// Number of legal moves as seen by the playout selection.
+inline uint32_t count_choices(Position& pos) {
+	MoveChoices choices;
+	if (pos.white_turn)
+		collect_choices<true>(pos, choices);
+	else
+		collect_choices<false>(pos, choices);
+	return choices.total;
+}
+
+// Runs n playouts from pos over the pool. Playouts are handed out in chunks seeded from the chunk index, so the
+// results only depend on the seed and not on the number of threads.
+inline PlayoutStats run_playouts(Position& pos, uint64_t n, ThreadPool& pool, uint64_t seed, int max_plies = 1000) {
+	constexpr uint64_t chunk = 256;
+	std::vector<PlayoutStats> per_thread(pool.size());
+	pool.parallel_for((n + chunk - 1) / chunk, [&](size_t c, unsigned thread) {
+		std::mt19937_64 rng(seed + c);
+		PlayoutStats& stats = per_thread[thread];
+		for (uint64_t i = c * chunk; i < std::min(n, (c + 1) * chunk); i++) playout(pos, rng, max_plies, stats);
+	});
+
+	PlayoutStats ret;
+	for (const PlayoutStats& s : per_thread) ret += s;
+	return ret;
+}
+
+};	// namespace pyke
+
+#endif
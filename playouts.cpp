@@ -0,0 +1,63 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "playout.hpp"
+
+// Random playouts to the end of the game from a position, reporting playouts/sec, plies/sec and the outcomes.
+
+const std::string start_fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+int main(int argc, char* argv[]) {
+	std::string fen = start_fen;
+	uint64_t n = 100000;
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	PinPolicy pin = PinPolicy::NONE;
+	uint64_t seed = 0x5eed;
+	int max_plies = 1000;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--fen" && i + 1 < argc) {
+			fen = argv[++i];
+		} else if (arg == "--playouts" && i + 1 < argc) {
+			n = std::stoull(argv[++i]);
+		} else if (arg == "--threads" && i + 1 < argc) {
+			threads = std::stoi(argv[++i]);
+		} else if (arg == "--pin" && i + 1 < argc) {
+			pin = parse_pin_policy(argv[++i]);
+		} else if (arg == "--seed" && i + 1 < argc) {
+			seed = std::stoull(argv[++i]);
+		} else if (arg == "--max-plies" && i + 1 < argc) {
+			max_plies = std::stoi(argv[++i]);
+		} else {
+			std::cout << "Usage: playouts [--fen FEN] [--playouts N] [--threads N] [--pin POLICY] [--seed N] "
+						 "[--max-plies N]\n";
+			return 1;
+		}
+	}
+
+	Position pos;
+	try {
+		pos.load_fen(fen);
+	} catch (const std::invalid_argument& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+
+	ThreadPool pool(threads, pin);
+	auto start = std::chrono::steady_clock::now();
+	PlayoutStats stats = pyke::run_playouts(pos, n, pool, seed, max_plies);
+	double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "Playouts: " << stats.playouts << " in " << s << " s\nThreads: " << pool.get_placement().describe()
+			  << '\n';
+	std::cout << "Playouts/s: " << uint64_t(stats.playouts / s) << "\nPlies/s: " << uint64_t(stats.plies / s)
+			  << "\nAverage length: " << double(stats.plies) / stats.playouts << " plies\n";
+	std::cout << "White wins: " << stats.white_wins << ", black wins: " << stats.black_wins
+			  << ", draws: " << stats.draws << '\n';
+	return 0;
+}
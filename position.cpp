@@ -1 +1,156 @@
 #include "position.hpp"
+
+#include <cctype>
+#include <sstream>
+
+void Position::load_fen(const std::string& fen) {
+	std::istringstream in(fen);
+	std::string placement, side, castling, ep;
+	if (!(in >> placement >> side)) throw std::invalid_argument("FEN is missing fields: " + fen);
+	in >> castling >> ep;
+
+	// Piece placement, starting at a8.
+	Board b;
+	for (bool white : {true, false}) {
+		for (Piece p : {PAWN, KING, ROOK, BISHOP, KNIGHT, QUEEN}) *b.get_board_pointer(white, p) = 0;
+	}
+	b.w_board = b.b_board = b.occ_board = 0;
+	Square s = 0;
+	for (char c : placement) {
+		if (c == '/') continue;
+		if (c >= '1' && c <= '8') {
+			s += c - '0';
+			continue;
+		}
+		if (s > 63) throw std::invalid_argument("FEN placement overflows the board: " + fen);
+		bool white = std::isupper(c);
+		Piece p;
+		switch (std::tolower(c)) {
+		case 'p':
+			p = PAWN;
+			break;
+		case 'n':
+			p = KNIGHT;
+			break;
+		case 'b':
+			p = BISHOP;
+			break;
+		case 'r':
+			p = ROOK;
+			break;
+		case 'q':
+			p = QUEEN;
+			break;
+		case 'k':
+			p = KING;
+			break;
+		default:
+			throw std::invalid_argument("Unknown piece in FEN: " + fen);
+		}
+		BitBoard mask = square_to_mask(s++);
+		*b.get_board_pointer(white, p) |= mask;
+		(white ? b.w_board : b.b_board) |= mask;
+		b.occ_board |= mask;
+	}
+	if (s != 64 || popcnt(b.w_king) != 1 || popcnt(b.b_king) != 1)
+		throw std::invalid_argument("FEN does not describe a valid board: " + fen);
+
+	board = b;
+	white_turn = side != "b";
+	wksq = lbit(b.w_king);
+	bksq = lbit(b.b_king);
+
+	bool wk = castling.find('K') != std::string::npos;
+	bool wq = castling.find('Q') != std::string::npos;
+	bool bk = castling.find('k') != std::string::npos;
+	bool bq = castling.find('q') != std::string::npos;
+	castling_rights = make_cr_flag(bk, bq, wk, wq);
+
+	// The ep flag is only set when a pawn of the side to move can actually take.
+	ep_flag = 0;
+	if (ep.size() == 2 && ep != "--") {
+		Square pawn_sq = notation_to_square(ep) + (white_turn ? 8 : -8);
+		File file = pawn_sq % 8;
+		BitBoard own_pawns = white_turn ? b.w_pawn : b.b_pawn;
+		if (file > 0 && (own_pawns & square_to_mask(pawn_sq - 1))) set_en_passant(true, file, ep_flag);
+		if (file < 7 && (own_pawns & square_to_mask(pawn_sq + 1))) set_en_passant(false, file, ep_flag);
+	}
+}
+
+void Position::play_move(const std::string& move) {
+	if (move.size() < 4) throw std::invalid_argument("Malformed move: " + move);
+	Square from = notation_to_square(move.substr(0, 2));
+	Square to = notation_to_square(move.substr(2, 2));
+	bool white = white_turn;
+	Piece p = white ? board.get_piece<true>(from) : board.get_piece<false>(from);
+	Piece captured = white ? board.get_piece<false>(to) : board.get_piece<true>(to);
+	if (p == EMPTY) throw std::invalid_argument("No piece to move for " + move);
+
+	auto toggle = [&](bool w, Piece piece, Square s) {
+		BitBoard mask = square_to_mask(s);
+		*board.get_board_pointer(w, piece) ^= mask;
+		(w ? board.w_board : board.b_board) ^= mask;
+		board.occ_board ^= mask;
+	};
+
+	// Ep captures land on an empty square diagonally.
+	if (p == PAWN && captured == EMPTY && from % 8 != to % 8) toggle(!white, PAWN, white ? to + 8 : to - 8);
+	if (captured != EMPTY) toggle(!white, captured, to);
+	toggle(white, p, from);
+	toggle(white, p, to);
+
+	if (move.size() > 4 && p == PAWN) {
+		Piece promotion;
+		switch (move[4]) {
+		case 'n':
+			promotion = KNIGHT;
+			break;
+		case 'b':
+			promotion = BISHOP;
+			break;
+		case 'r':
+			promotion = ROOK;
+			break;
+		default:
+			promotion = QUEEN;
+		}
+		toggle(white, PAWN, to);
+		toggle(white, promotion, to);
+	}
+
+	// Castling moves the rook along.
+	if (p == KING) {
+		if (to == from + 2) {
+			toggle(white, ROOK, from + 3);
+			toggle(white, ROOK, from + 1);
+		} else if (from == to + 2) {
+			toggle(white, ROOK, from - 4);
+			toggle(white, ROOK, from - 1);
+		}
+		if (white)
+			wksq = to;
+		else
+			bksq = to;
+	}
+
+	// Moves from or to a king or rook start square drop the matching rights.
+	for (Square s : {from, to}) {
+		if (s == king_start_squares[0]) castling_rights = rm_cr_w(castling_rights);
+		if (s == king_start_squares[2]) castling_rights = rm_cr_b(castling_rights);
+		if (s == rook_start_squares[0]) castling_rights = rm_cr_wk(castling_rights);
+		if (s == rook_start_squares[1]) castling_rights = rm_cr_wq(castling_rights);
+		if (s == rook_start_squares[2]) castling_rights = rm_cr_bk(castling_rights);
+		if (s == rook_start_squares[3]) castling_rights = rm_cr_bq(castling_rights);
+	}
+
+	// Same ep encoding as pawn_double: only set when an enemy pawn stands next to the pushed pawn.
+	ep_flag = 0;
+	if (p == PAWN && (to == from + 16 || from == to + 16)) {
+		File file = to % 8;
+		BitBoard opp_pawns = white ? board.b_pawn : board.w_pawn;
+		if (file > 0 && (opp_pawns & square_to_mask(to - 1))) set_en_passant(true, file, ep_flag);
+		if (file < 7 && (opp_pawns & square_to_mask(to + 1))) set_en_passant(false, file, ep_flag);
+	}
+
+	white_turn = !white;
+}
@@ -1,11 +1,14 @@
 #include <cstddef>
 #include <cstdint>
 #include <stdexcept>
+#include <string>
 
 #include "board.hpp"
 #include "gamestate.hpp"
 #include "maskset.hpp"
+#include "material.hpp"
 #include "move.hpp"
+#include "reply_counts.hpp"
 #include "stack.hpp"
 
 #ifndef POSITION_H
@@ -15,11 +18,21 @@ struct Position {
 	Position() {}
 
 	Board board;
-	uint8_t ep_flag;
+	uint8_t ep_flag = 0;
 	bool white_turn = true;
 	Stack<MaskSet> masks;
+	// Knight and slider replies counted by the last node two plies above the leaves, for count_replies.
+	ReplyCounts replies;
 	Square bksq = 4;
 	Square wksq = 60;
+	CastlingRights castling_rights = make_cr_flag(1, 1, 1, 1);
+
+	// Sets up the position from a FEN string. Throws std::invalid_argument on malformed input.
+	void load_fen(const std::string& fen);
+
+	// Plays a move in long algebraic notation (e2e4, e1g1, e7e8q), updating castling rights, ep flag and side to move.
+	// The move is not checked for legality. Throws std::invalid_argument if there is no own piece on the from square.
+	void play_move(const std::string& move);
 
 	template <bool white>
 	constexpr inline void set_ksq(const Square ksq) {
@@ -44,18 +57,50 @@ struct Position {
 		return board.get_piece_board<white, p>();
 	}
 
-	// Returns whether a square is under attack.
-	template <bool white>
+	// Returns whether a square is under attack. Attacks by piece kinds the signature rules out are not probed.
+	template <bool white, MaterialMask mat = all_material>
 	inline bool is_attacked(Square square) {
-		return (get_pawn_move<white, PawnMoveType::ATTACKS>(square, board.occ_board)
-				& board.get_piece_board<!white, PAWN>())
+		return (has_pawns(mat)
+				&& (get_pawn_move<white, PawnMoveType::ATTACKS>(square, board.occ_board)
+					& board.get_piece_board<!white, PAWN>()))
 			|| (get_knight_move(square) & board.get_piece_board<!white, KNIGHT>())
-			|| (get_rook_move(square, board.occ_board)
-				& (board.get_piece_board<!white, ROOK>() | board.get_piece_board<!white, QUEEN>()))
-			|| (get_bishop_move(square, board.occ_board)
-				& (board.get_piece_board<!white, BISHOP>() | board.get_piece_board<!white, QUEEN>()))
+			|| (has_sliders<!white>(mat)
+				&& (get_rook_move(square, board.occ_board)
+					& (board.get_piece_board<!white, ROOK>() | board.get_piece_board<!white, QUEEN>())))
+			|| (has_sliders<!white>(mat)
+				&& (get_bishop_move(square, board.occ_board)
+					& (board.get_piece_board<!white, BISHOP>() | board.get_piece_board<!white, QUEEN>())))
 			|| (get_king_move(square) & board.get_piece_board<!white, KING>());
 	}
+
+	// Returns the squares among the given ones the opponent attacks, with the own king off the board so that the
+	// squares behind it on a checking line count as attacked. Sliders whose lines miss all of them are not looked up.
+	template <bool white, MaterialMask mat = all_material>
+	inline BitBoard king_danger(BitBoard squares) {
+		if (!squares) return 0;
+		BitBoard occ = board.occ_board & ~board.get_piece_board<white, KING>();
+		BitBoard danger = get_king_move(get_ksq<!white>());
+		if constexpr (has_pawns(mat)) {
+			BitBoard pawns = board.get_piece_board<!white, PAWN>();
+			danger |= get_pawn_left<!white>(can_capture_left(pawns)) | get_pawn_right<!white>(can_capture_right(pawns));
+		}
+		BitBoard knights = board.get_piece_board<!white, KNIGHT>();
+		while (knights) danger |= get_knight_move(pop(knights));
+		if constexpr (has_sliders<!white>(mat)) {
+			BitBoard queens = board.get_piece_board<!white, QUEEN>();
+			BitBoard diag = board.get_piece_board<!white, BISHOP>() | queens;
+			BitBoard orth = board.get_piece_board<!white, ROOK>() | queens;
+			while (diag) {
+				Square s = pop(diag);
+				if (diag_lines[s] & squares) danger |= get_bishop_move(s, occ);
+			}
+			while (orth) {
+				Square s = pop(orth);
+				if (orth_lines[s] & squares) danger |= get_rook_move(s, occ);
+			}
+		}
+		return danger & squares;
+	}
 };
 
 #endif
@@ -5,31 +5,60 @@
 #include "gamestate.hpp"
 #include "make_move.hpp"
 #include "maskset.hpp"
+#include "material.hpp"
 #include "move.hpp"
 #include "piece_moves.hpp"
 #include "position.hpp"
 #include "stack.hpp"
 #include "util.hpp"
+#include "visitor.hpp"
 
 #ifndef PYKE_H
 #define PYKE_H
 
 namespace pyke {
 
-template <bool white, int dtg, bool print_move, CastlingRights cr, bool ep>
+template <bool white, int dtg, TreeVisitor V, CastlingRights cr, MaterialMask mat, bool ep>
 uint64_t count_moves(Position& pos);
 
+/*
+ *	CAPTURES
+ */
+
+// Counts the child of a capture on the given square. Taking a rook on its start square removes the opponent's
+// castling right on that side. Without castling rights, taking the last slider or pawn switches the child to the
+// signature without them.
+template <bool white, int dtg, TreeVisitor V, CastlingRights cr, MaterialMask mat>
+static inline uint64_t count_after_capture(Square to, Piece captured, Position& pos) {
+	if constexpr (has_cr_right<!white, true, cr>() || has_cr_right<!white, false, cr>()) {
+		constexpr int rook_sq_index = 2 * white;
+		if (captured == ROOK && to == rook_start_squares[rook_sq_index])
+			return count_moves<!white, dtg - 1, typename V::Child, rm_cr<!white, true>(cr), mat>(pos);
+		if (captured == ROOK && to == rook_start_squares[rook_sq_index + 1])
+			return count_moves<!white, dtg - 1, typename V::Child, rm_cr<!white, false>(cr), mat>(pos);
+	}
+	if constexpr (cr == 0 && dtg > 2 && has_sliders<!white>(mat)) {
+		if (captured != PAWN && captured != KNIGHT && !slider_board<!white>(pos.board))
+			return count_moves<!white, dtg - 1, typename V::Child, cr, mat | no_sliders<!white>()>(pos);
+	}
+	if constexpr (cr == 0 && dtg > 2 && has_pawns(mat)) {
+		if (captured == PAWN && !(pos.board.get_piece_board<true, PAWN>() | pos.board.get_piece_board<false, PAWN>()))
+			return count_moves<!white, dtg - 1, typename V::Child, cr, mat | no_pawns>(pos);
+	}
+	return count_moves<!white, dtg - 1, typename V::Child, cr, mat>(pos);
+}
+
 /*
  *	ROOK
  */
 
 // Count rook moves.
-template <bool white, Piece p, bool capture, int dtg, bool print_move, CastlingRights cr>
+template <bool white, Piece p, bool capture, int dtg, TreeVisitor V, CastlingRights cr, MaterialMask mat>
 static inline uint64_t generate_rook_moves(BitBoard cmt, Square from, Position& pos) {
 	if (!cmt) return 0;
 	uint64_t ret = 0;
-	bool rm_ks = from == rook_start_squares[!white];
-	bool rm_qs = from == rook_start_squares[!white + 1];
+	bool rm_ks = from == rook_start_squares[2 * !white];
+	bool rm_qs = from == rook_start_squares[2 * !white + 1];
 
 	while (cmt) {
 		uint64_t loc_ret = 0;
@@ -41,18 +70,18 @@ static inline uint64_t generate_rook_moves(BitBoard cmt, Square from, Position&
 			BitBoard to_mask = square_to_mask(to);
 
 			capture_move_wrapper<white, p>(pos.board, captured, move, to_mask);
-			loc_ret += rm_ks ? count_moves<!white, dtg - 1, false, rm_cr<white, true>(cr)>(pos)
-				: rm_qs		 ? count_moves<!white, dtg - 1, false, rm_cr<white, false>(cr)>(pos)
-							 : count_moves<!white, dtg - 1, false, cr>(pos);
+			loc_ret += rm_ks ? count_after_capture<white, dtg, V, rm_cr<white, true>(cr), mat>(to, captured, pos)
+				: rm_qs		 ? count_after_capture<white, dtg, V, rm_cr<white, false>(cr), mat>(to, captured, pos)
+							 : count_after_capture<white, dtg, V, cr, mat>(to, captured, pos);
 			unmake_capture_wrapper<white, p>(pos.board, captured, move, to_mask);
 		} else {
 			plain_move<white, p>(pos.board, move);
-			loc_ret += rm_ks ? count_moves<!white, dtg - 1, false, rm_cr<white, true>(cr)>(pos)
-				: rm_qs		 ? count_moves<!white, dtg - 1, false, rm_cr<white, false>(cr)>(pos)
-							 : count_moves<!white, dtg - 1, false, cr>(pos);
+			loc_ret += rm_ks ? count_moves<!white, dtg - 1, typename V::Child, rm_cr<white, true>(cr), mat>(pos)
+				: rm_qs		 ? count_moves<!white, dtg - 1, typename V::Child, rm_cr<white, false>(cr), mat>(pos)
+							 : count_moves<!white, dtg - 1, typename V::Child, cr, mat>(pos);
 			unmake_plain_move<white, p>(pos.board, move);
 		}
-		if constexpr (print_move) print_movecnt(from, to, loc_ret);
+		V::moved(from, to, EMPTY, loc_ret);
 		ret += loc_ret;
 	}
 	return ret;
@@ -62,11 +91,11 @@ static inline uint64_t generate_rook_moves(BitBoard cmt, Square from, Position&
  *	GENERAL
  */
 
-template <bool white, Piece p, int dtg, bool print_move, CastlingRights cr>
+template <bool white, Piece p, int dtg, TreeVisitor V, CastlingRights cr, MaterialMask mat>
 static inline uint64_t count_captures(BitBoard cmt, Square from, Position& pos) {
 	if (!cmt) return 0;
 	if constexpr (p == ROOK) {
-		return generate_rook_moves<white, ROOK, true, dtg, print_move, cr>(cmt, from, pos);
+		return generate_rook_moves<white, ROOK, true, dtg, V, cr, mat>(cmt, from, pos);
 	} else {
 		uint64_t ret = 0;
 		while (cmt) {
@@ -78,30 +107,21 @@ static inline uint64_t count_captures(BitBoard cmt, Square from, Position& pos)
 			BitBoard to_mask = square_to_mask(to);
 
 			capture_move_wrapper<white, p>(pos.board, captured, move, to_mask);
-			if (captured == ROOK) {
-				constexpr int rook_sq_index = 2 * white;
-				const bool rm_ks = to == rook_start_squares[rook_sq_index];
-				const bool rm_qs = to == rook_start_squares[rook_sq_index + 1];
-				loc_ret += rm_ks ? count_moves<!white, dtg - 1, false, rm_cr<!white, true>(cr)>(pos)
-					: rm_qs		 ? count_moves<!white, dtg - 1, false, rm_cr<!white, false>(cr)>(pos)
-								 : count_moves<!white, dtg - 1, false, cr>(pos);
-			} else {
-				loc_ret += count_moves<!white, dtg - 1, false, cr>(pos);
-			}
+			loc_ret += count_after_capture<white, dtg, V, cr, mat>(to, captured, pos);
 			unmake_capture_wrapper<white, p>(pos.board, captured, move, to_mask);
 
-			if constexpr (print_move) print_movecnt(from, to, loc_ret);
+			V::moved(from, to, EMPTY, loc_ret);
 			ret += loc_ret;
 		}
 		return ret;
 	}
 }
 
-template <bool white, Piece p, int dtg, bool print_move, CastlingRights cr>
+template <bool white, Piece p, int dtg, TreeVisitor V, CastlingRights cr, MaterialMask mat>
 static inline uint64_t count_plain(BitBoard cmt, Square from, Position& pos) {
 	if (!cmt) return 0;
 	if constexpr (p == ROOK) {
-		return generate_rook_moves<white, ROOK, false, dtg, print_move, cr>(cmt, from, pos);
+		return generate_rook_moves<white, ROOK, false, dtg, V, cr, mat>(cmt, from, pos);
 	} else {
 		uint64_t ret = 0;
 		while (cmt) {
@@ -110,10 +130,10 @@ static inline uint64_t count_plain(BitBoard cmt, Square from, Position& pos) {
 			BitBoard move = square_to_mask(from) | square_to_mask(to);
 
 			plain_move<white, p>(pos.board, move);
-			loc_ret += count_moves<!white, dtg - 1, false, cr>(pos);
+			loc_ret += count_moves<!white, dtg - 1, typename V::Child, cr, mat>(pos);
 			unmake_plain_move<white, p>(pos.board, move);
 
-			if constexpr (print_move) print_movecnt(from, to, loc_ret);
+			V::moved(from, to, EMPTY, loc_ret);
 			ret += loc_ret;
 		}
 		return ret;
@@ -121,14 +141,14 @@ static inline uint64_t count_plain(BitBoard cmt, Square from, Position& pos) {
 }
 
 // Splits the reachable squares into non-captures and captures and calls the appropriate function.
-template <bool white, Piece p, int dtg, bool print_move, CastlingRights cr, MoveType mt = p>
+template <bool white, Piece p, int dtg, TreeVisitor V, CastlingRights cr, MaterialMask mat, MoveType mt = p>
 static inline uint64_t generate_moves(BitBoard cmt, BitBoard pieces, Position& pos) {
 	if (!(cmt && pieces)) return 0;
 	uint64_t ret = 0;
 	// For all instances of given piece.
 	while (pieces) {
 		Square from = pop(pieces);
-		if constexpr (dtg <= 1 && !print_move) {
+		if constexpr (dtg <= 1 && V::bulk) {
 			ret += popcnt(cmt & make_reach_board<white, p>(from, pos.board));
 		} else {
 			BitBoard piece_moves_to = cmt & make_reach_board<white, mt>(from, pos.board);
@@ -136,8 +156,8 @@ static inline uint64_t generate_moves(BitBoard cmt, BitBoard pieces, Position& p
 			BitBoard non_captures = piece_moves_to & ~captures;
 
 			// Non-captures + captured.
-			ret += count_plain<white, p, dtg, print_move, cr>(non_captures, from, pos);
-			ret += count_captures<white, p, dtg, print_move, cr>(captures, from, pos);
+			ret += count_plain<white, p, dtg, V, cr, mat>(non_captures, from, pos);
+			ret += count_captures<white, p, dtg, V, cr, mat>(captures, from, pos);
 		}
 	}
 	return ret;
@@ -147,39 +167,52 @@ static inline uint64_t generate_moves(BitBoard cmt, BitBoard pieces, Position& p
  *	KING
  */
 
-// Create the castling move for given player and direction.
-template <bool white, bool kingside, int dtg, bool print_move, CastlingRights cr>
-static inline uint64_t generate_castle_move(Position& pos) {
+// The squares the king crosses or lands on when castling with the rights in cr.
+template <bool white, CastlingRights cr>
+static constexpr BitBoard castle_squares() {
+	BitBoard ret = 0;
+	if (has_cr_right<white, true, cr>()) ret |= square_to_mask(white ? 61 : 5) | square_to_mask(white ? 62 : 6);
+	if (has_cr_right<white, false, cr>()) ret |= square_to_mask(white ? 59 : 3) | square_to_mask(white ? 58 : 2);
+	return ret;
+}
+
+// Create the castling move for given player and direction. Danger holds the attacked squares among castle_squares.
+template <bool white, bool kingside, int dtg, TreeVisitor V, CastlingRights cr, MaterialMask mat>
+static inline uint64_t generate_castle_move(BitBoard danger, Position& pos) {
 	Board& b = pos.board;
 	constexpr Square to = white ? (kingside ? 62 : 58) : (kingside ? 6 : 2);
 	constexpr Square middle_square = white ? (kingside ? 61 : 59) : (kingside ? 5 : 3);
 	constexpr Square ksq = white ? 60 : 4;
 
-	if (b.square_occ(to) | b.square_occ(middle_square)) {
+	if constexpr (!has_cr_right<white, kingside, cr>()) {
+		return 0;
+	} else if (b.square_occ(to) | b.square_occ(middle_square)) {
 		return 0;
 	} else if (!kingside && b.square_occ(queenside_middle_squares[white])) {
 		return 0;
-	} else if (pos.is_attacked<white>(middle_square) || pos.is_attacked<white>(to)) {
+	} else if (danger & (square_to_mask(middle_square) | square_to_mask(to))) {
 		return 0;
-	} else if constexpr (dtg <= 1 && !print_move) {
+	} else if constexpr (dtg <= 1 && V::bulk) {
 		return 1;
 	} else {
 		constexpr uint8_t code = white ? (kingside ? 0 : 1) : (kingside ? 2 : 3);
 		castle_move<white, code>(pos.board);
 		pos.set_ksq<white>(to);
-		uint64_t ret = count_moves<!white, dtg - 1, false, white ? rm_cr_w(cr) : rm_cr_b(cr)>(pos);
+		uint64_t ret = count_moves<!white, dtg - 1, typename V::Child, white ? rm_cr_w(cr) : rm_cr_b(cr), mat>(pos);
 		unmake_castle_move<white, code>(pos.board);
 		pos.set_ksq<white>(ksq);
-		if constexpr (print_move) print_movecnt(ksq, to, ret);
+		V::moved(ksq, to, EMPTY, ret);
 		return ret;
 	}
 }
 
-// Create king moves.
-template <bool white, int dtg, bool print_move, CastlingRights cr>
-static inline uint64_t generate_king_moves(BitBoard cmt, Position& pos) {
+// Create king moves. Danger holds the attacked squares among the king's targets, so the moves left are legal and
+// counted in bulk at the leaves.
+template <bool white, int dtg, TreeVisitor V, CastlingRights cr, MaterialMask mat>
+static inline uint64_t generate_king_moves(BitBoard cmt, BitBoard danger, Position& pos) {
 	Square ksq = pos.get_ksq<white>();
-	cmt &= get_king_move(ksq);
+	cmt &= get_king_move(ksq) & ~danger;
+	if constexpr (dtg <= 1 && V::bulk) return popcnt(cmt);
 	BitBoard captures = cmt & pos.board.get_player_occ<!white>();
 	BitBoard non_captures = cmt & ~captures;
 	uint64_t ret = 0;
@@ -190,10 +223,10 @@ static inline uint64_t generate_king_moves(BitBoard cmt, Position& pos) {
 
 		plain_move<white, KING>(pos.board, move);
 		pos.set_ksq<white>(to);
-		if (!pos.is_attacked<white>(to)) loc_ret += count_moves<!white, dtg - 1, false, rm_cr<white>(cr)>(pos);
+		loc_ret += count_moves<!white, dtg - 1, typename V::Child, rm_cr<white>(cr), mat>(pos);
 		unmake_plain_move<white, KING>(pos.board, move);
 
-		if constexpr (print_move) print_movecnt(ksq, to, loc_ret);
+		V::moved(ksq, to, EMPTY, loc_ret);
 		ret += loc_ret;
 	}
 
@@ -206,10 +239,10 @@ static inline uint64_t generate_king_moves(BitBoard cmt, Position& pos) {
 
 		capture_move_wrapper<white, KING>(pos.board, captured, move, to_mask);
 		pos.set_ksq<white>(to);
-		if (!pos.is_attacked<white>(to)) loc_ret += count_moves<!white, dtg - 1, false, rm_cr<white>(cr)>(pos);
+		loc_ret += count_after_capture<white, dtg, V, rm_cr<white>(cr), mat>(to, captured, pos);
 		unmake_capture_wrapper<white, KING>(pos.board, captured, move, to_mask);
 
-		if constexpr (print_move) print_movecnt(ksq, to, loc_ret);
+		V::moved(ksq, to, EMPTY, loc_ret);
 		ret += loc_ret;
 	}
 
@@ -222,70 +255,83 @@ static inline uint64_t generate_king_moves(BitBoard cmt, Position& pos) {
  *	PAWNS
  */
 
-// Generate all possible promotion moves.
-template <bool white, int dtg, bool print_move>
-static inline uint64_t generate_promotions(Position& pos, BitBoard cmt, BitBoard source) {
-	return 0;
-	/*all         Board::is_equal(Board const&
-	const auto generate_promo_pieces = [&](const Piece piece, const Piece captured, Square from, Square to) {
-		promo_move<white, piece, captured>(from, to, pos);
-		int count = 1 + count_moves<!white, dtg - 1>(pos);
-		unmake_promo_move<white, piece, captured>(from, to, pos);
-		return count;
-	};
-	int ret = 0;
-	while (source) {
-		Square from = pop(source);
-		while (cmt) {
-			Square to = pop(cmt);
-			if constexpr (dtg <= 1) {
-				return 4;
-			} else {
-				const Piece at_to = pos.board.get_piece<white>(to);
-				ret += generate_promo_pieces(ROOK, at_to, from, to);
-				ret += generate_promo_pieces(KNIGHT, at_to, from, to);
-				ret += generate_promo_pieces(BISHOP, at_to, from, to);
-				ret += generate_promo_pieces(QUEEN, at_to, from, to);
+// Make a promotion to the given piece and count. Promoting to a slider brings sliders back into the signature.
+template <bool white, Piece p, int dtg, TreeVisitor V, CastlingRights cr, MaterialMask mat>
+static inline uint64_t make_promotion(Square from, Square to, Piece captured, Position& pos) {
+	BitBoard to_mask = square_to_mask(to);
+	BitBoard move = square_to_mask(from) | to_mask;
+	constexpr MaterialMask child_mat = p == KNIGHT ? mat : mat & ~no_sliders<white>();
+
+	promo_move<white, p>(pos.board, captured, move, to_mask);
+	uint64_t loc_ret = captured == EMPTY ? count_moves<!white, dtg - 1, typename V::Child, cr, child_mat>(pos)
+										 : count_after_capture<white, dtg, V, cr, child_mat>(to, captured, pos);
+	unmake_promo_move<white, p>(pos.board, captured, move, to_mask);
+
+	V::moved(from, to, p, loc_ret);
+	return loc_ret;
+}
+
+// Generate all possible promotion moves, four per target square.
+template <bool white, int dtg, TreeVisitor V, CastlingRights cr, MaterialMask mat>
+static inline uint64_t generate_promotions(BitBoard cmt, BitBoard pieces, Position& pos) {
+	if (!(cmt && pieces)) return 0;
+	BitBoard occ = pos.board.occ_board;
+	BitBoard cmt_free = cmt & ~occ;
+	BitBoard cmt_captures = cmt & occ;
+
+	if constexpr (dtg <= 1 && V::bulk) {
+		return 4
+			* (popcnt(get_pawn_forward<white>(pieces) & cmt_free)
+			   + popcnt(get_pawn_left<white>(can_capture_left(pieces)) & cmt_captures)
+			   + popcnt(get_pawn_right<white>(can_capture_right(pieces)) & cmt_captures));
+	} else {
+		uint64_t ret = 0;
+		while (pieces) {
+			Square from = pop(pieces);
+			BitBoard to_board = (get_pawn_move<white, PawnMoveType::ATTACKS>(from, occ) & cmt_captures)
+				| (get_pawn_move<white, PawnMoveType::FORWARD>(from, occ) & cmt_free);
+			while (to_board) {
+				Square to = pop(to_board);
+				const Piece captured = pos.board.get_piece<!white>(to);
+				ret += make_promotion<white, QUEEN, dtg, V, cr, mat>(from, to, captured, pos);
+				ret += make_promotion<white, ROOK, dtg, V, cr, mat>(from, to, captured, pos);
+				ret += make_promotion<white, BISHOP, dtg, V, cr, mat>(from, to, captured, pos);
+				ret += make_promotion<white, KNIGHT, dtg, V, cr, mat>(from, to, captured, pos);
 			}
 		}
+		return ret;
 	}
-	return ret;
-*/
 }
 
-// Make ep move and ocunt. Offset is whether ep comes from left or right.
-template <bool white, int offset, int dtg, bool print_move, CastlingRights cr>
-static inline uint64_t make_en_passant(Position& pos, uint8_t ep, MaskSet& msk) {
+// Make ep move and count. Offset is whether ep comes from left or right. Legality is tested on the resulting board,
+// as ep can uncover the king along the rank of both pawns.
+template <bool white, int offset, int dtg, TreeVisitor V, CastlingRights cr, MaterialMask mat>
+static inline uint64_t make_en_passant(Position& pos, uint8_t ep) {
 	uint64_t loc_ret;
 	sq_pair epsq = get_ep_squares<white, offset>(ep);
 	BitBoard move = square_to_mask(epsq.first) | square_to_mask(epsq.second);
 	BitBoard capture_sq = square_to_mask(white ? epsq.second + 8 : epsq.second - 8);
-	if (capture_sq & msk.pinmask_dg) return 0;
 
 	ep_move<white>(pos.board, move, capture_sq);
-
-	if (square_to_mask(epsq.first) & msk.nopin)
-		loc_ret = count_moves<!white, dtg - 1, false, cr>(pos);
-	else
-		loc_ret = !pos.is_attacked<white>(pos.get_ksq<white>()) ? count_moves<!white, dtg - 1, false, cr>(pos) : 0;
-
+	bool legal = !pos.is_attacked<white, mat>(pos.get_ksq<white>());
+	loc_ret = legal ? count_moves<!white, dtg - 1, typename V::Child, cr, mat>(pos) : 0;
 	unmake_ep_move<white>(pos.board, move, capture_sq);
 
-	if constexpr (print_move) print_movecnt(epsq.first, epsq.second, loc_ret);
+	V::moved(epsq.first, epsq.second, EMPTY, loc_ret);
 	return loc_ret;
 };
 
 // Count nodes following from ep moves.
-template <bool white, int dtg, bool print_move, CastlingRights cr>
-static inline uint64_t generate_ep_moves(Position& pos, uint8_t ep, MaskSet& msk) {
-	return (ep & 0x80 ? make_en_passant<white, -1, dtg, print_move, cr>(pos, ep, msk) : 0)
-		+ (ep & 0x40 ? make_en_passant<white, 1, dtg, print_move, cr>(pos, ep, msk) : 0);
+template <bool white, int dtg, TreeVisitor V, CastlingRights cr, MaterialMask mat>
+static inline uint64_t generate_ep_moves(Position& pos, uint8_t ep) {
+	return (ep & 0x80 ? make_en_passant<white, -1, dtg, V, cr, mat>(pos, ep) : 0)
+		+ (ep & 0x40 ? make_en_passant<white, 1, dtg, V, cr, mat>(pos, ep) : 0);
 }
 
 // Pawn double pushes.
-template <bool white, int dtg, bool print_move, CastlingRights cr>
+template <bool white, int dtg, TreeVisitor V, CastlingRights cr, MaterialMask mat>
 static inline NodeCount generate_pawn_double(BitBoard cmt, Position& pos, BitBoard source) {
-	if constexpr (dtg <= 1 && !print_move) {
+	if constexpr (dtg <= 1 && V::bulk) {
 		return popcnt(get_pawn_double<white>(source, pos.board.occ_board) & cmt);
 	} else {
 		NodeCount ret = 0;
@@ -296,10 +342,10 @@ static inline NodeCount generate_pawn_double(BitBoard cmt, Position& pos, BitBoa
 				BitBoard to = popextr(to_board);
 				BitBoard move = from | to;
 				bool ep = pawn_double<white>(pos.board, move, to, pos.ep_flag);
-				NodeCount loc_ret = ep ? count_moves<!white, dtg - 1, false, cr, true>(pos)
-									   : count_moves<!white, dtg - 1, false, cr, false>(pos);
+				NodeCount loc_ret = ep ? count_moves<!white, dtg - 1, typename V::Child, cr, mat, true>(pos)
+									   : count_moves<!white, dtg - 1, typename V::Child, cr, mat, false>(pos);
 				unmake_pawn_double<white>(pos.board, move);
-				if constexpr (print_move) print_movecnt(lbit(from), lbit(to), loc_ret);
+				V::moved(lbit(from), lbit(to), EMPTY, loc_ret);
 				ret += loc_ret;
 			}
 		}
@@ -308,17 +354,17 @@ static inline NodeCount generate_pawn_double(BitBoard cmt, Position& pos, BitBoa
 }
 
 // Concrete generator for pawn moves. Creates double pushes, pushes and captures, in bulk if possible.
-template <bool white, int dtg, bool print_move, CastlingRights cr>
+template <bool white, int dtg, TreeVisitor V, CastlingRights cr, MaterialMask mat>
 static inline uint64_t generate_pawn_moves(BitBoard cmt, BitBoard pieces, Position& pos) {
 	if (!(cmt && pieces)) return 0;
 	BitBoard occ = pos.board.occ_board;
 	BitBoard cmt_free = cmt & ~occ;
 	BitBoard cmt_captures = cmt & occ;
 	BitBoard pawns_on_start = pieces & (white ? pawn_start_w : pawn_start_b);
-	uint64_t ret = generate_pawn_double<white, dtg, print_move, cr>(cmt, pos, pawns_on_start);
+	uint64_t ret = generate_pawn_double<white, dtg, V, cr, mat>(cmt, pos, pawns_on_start);
 
 	// Generate moves in bulk.
-	if constexpr (dtg <= 1 && !print_move) {
+	if constexpr (dtg <= 1 && V::bulk) {
 		ret += popcnt(get_pawn_forward<white>(pieces) & cmt_free);
 		ret += popcnt(get_pawn_left<white>(can_capture_left(pieces)) & cmt_captures);
 		ret += popcnt(get_pawn_right<white>(can_capture_right(pieces)) & cmt_captures);
@@ -327,32 +373,36 @@ static inline uint64_t generate_pawn_moves(BitBoard cmt, BitBoard pieces, Positi
 			Square from = pop(pieces);
 			BitBoard captures = get_pawn_move<white, PawnMoveType::ATTACKS>(from, occ) & cmt_captures;
 			BitBoard non_captures = get_pawn_move<white, PawnMoveType::FORWARD>(from, occ) & cmt_free;
-			ret += count_plain<white, PAWN, dtg, print_move, cr>(non_captures, from, pos);
-			ret += count_captures<white, PAWN, dtg, print_move, cr>(captures, from, pos);
+			ret += count_plain<white, PAWN, dtg, V, cr, mat>(non_captures, from, pos);
+			ret += count_captures<white, PAWN, dtg, V, cr, mat>(captures, from, pos);
 		}
 	}
 	return ret;
 }
 
-// Wrapper.
-template <bool white, int dtg, bool print_move, CastlingRights cr>
+// Wrapper. Pinned pawns are split by pin direction so each group only moves along its own pin rays.
+template <bool white, int dtg, TreeVisitor V, CastlingRights cr, MaterialMask mat>
 static inline uint64_t generate_pawn(Position& pos, MaskSet& msk) {
 	BitBoard can_move_from = pos.board.get_piece_board<white, PAWN>();
 	BitBoard pawns_on_promo = can_move_from & (white ? promotion_from_w : promotion_from_b);
 	can_move_from &= ~pawns_on_promo;
-	BitBoard pinned = can_move_from & ~msk.nopin;
-	BitBoard unpinned = can_move_from & msk.nopin;
+	BitBoard pin_cmt_diag = msk.cmt & msk.pinmask_dg;
+	BitBoard pin_cmt_orth = msk.cmt & msk.pinmask_orth;
 
-	// Unpinned + pinned.
-	return generate_pawn_moves<white, dtg, print_move, cr>(msk.cmt, unpinned, pos)
-		+ generate_pawn_moves<white, dtg, print_move, cr>(msk.cmt & ~msk.nopin, pinned, pos);
+	// Unpinned + pinned, for regular moves and promotions.
+	return generate_pawn_moves<white, dtg, V, cr, mat>(msk.cmt, can_move_from & msk.nopin, pos)
+		+ generate_pawn_moves<white, dtg, V, cr, mat>(pin_cmt_diag, can_move_from & msk.pinmask_dg, pos)
+		+ generate_pawn_moves<white, dtg, V, cr, mat>(pin_cmt_orth, can_move_from & msk.pinmask_orth, pos)
+		+ generate_promotions<white, dtg, V, cr, mat>(msk.cmt, pawns_on_promo & msk.nopin, pos)
+		+ generate_promotions<white, dtg, V, cr, mat>(pin_cmt_diag, pawns_on_promo & msk.pinmask_dg, pos)
+		+ generate_promotions<white, dtg, V, cr, mat>(pin_cmt_orth, pawns_on_promo & msk.pinmask_orth, pos);
 }
 
 /*
  *	SLIDERS
  */
 
-template <bool white, int dtg, bool print_move, CastlingRights cr>
+template <bool white, int dtg, TreeVisitor V, CastlingRights cr, MaterialMask mat>
 static inline uint64_t generate_sliders(Position& pos, MaskSet& msk) {
 	BitBoard bishops = pos.board.get_piece_board<white, BISHOP>();
 	BitBoard rooks = pos.board.get_piece_board<white, ROOK>();
@@ -370,13 +420,13 @@ static inline uint64_t generate_sliders(Position& pos, MaskSet& msk) {
 	BitBoard pin_q_orth = queens & orth_not_dg;
 
 	// Pinned + unpinned.
-	return generate_moves<white, BISHOP, dtg, print_move, cr>(pin_cmt_diag, pin_b, pos)
-		+ generate_moves<white, BISHOP, dtg, print_move, cr>(msk.cmt, unp_b, pos)
-		+ generate_moves<white, QUEEN_DIAG, dtg, print_move, cr>(pin_cmt_diag, pin_q_diag, pos)
-		+ generate_moves<white, QUEEN, dtg, print_move, cr>(msk.cmt, unp_q, pos)
-		+ generate_moves<white, QUEEN_ORTH, dtg, print_move, cr>(pin_cmt_orth, pin_q_orth, pos)
-		+ generate_moves<white, ROOK, dtg, print_move, cr>(pin_cmt_orth, pin_r, pos)
-		+ generate_moves<white, ROOK, dtg, print_move, cr>(msk.cmt, unp_r, pos);
+	return generate_moves<white, BISHOP, dtg, V, cr, mat>(pin_cmt_diag, pin_b, pos)
+		+ generate_moves<white, BISHOP, dtg, V, cr, mat>(msk.cmt, unp_b, pos)
+		+ generate_moves<white, QUEEN_DIAG, dtg, V, cr, mat>(pin_cmt_diag, pin_q_diag, pos)
+		+ generate_moves<white, QUEEN, dtg, V, cr, mat>(msk.cmt, unp_q, pos)
+		+ generate_moves<white, QUEEN_ORTH, dtg, V, cr, mat>(pin_cmt_orth, pin_q_orth, pos)
+		+ generate_moves<white, ROOK, dtg, V, cr, mat>(pin_cmt_orth, pin_r, pos)
+		+ generate_moves<white, ROOK, dtg, V, cr, mat>(msk.cmt, unp_r, pos);
 }
 
 /*
@@ -384,52 +434,318 @@ static inline uint64_t generate_sliders(Position& pos, MaskSet& msk) {
  */
 
 // Count knight moves.
-template <bool white, int dtg, bool print_move, CastlingRights cr>
+template <bool white, int dtg, TreeVisitor V, CastlingRights cr, MaterialMask mat>
 static inline NodeCount generate_knight(Position& pos, MaskSet& msk) {
-	return generate_moves<white, KNIGHT, dtg, print_move, cr>(msk.cmt, pos.piece_brd<white, KNIGHT>() & msk.nopin, pos);
+	return generate_moves<white, KNIGHT, dtg, V, cr, mat>(msk.cmt, pos.piece_brd<white, KNIGHT>() & msk.nopin, pos);
+}
+
+/*
+ *	EVASIONS
+ */
+
+// Count the moves of the given pieces onto one square.
+template <bool white, Piece p, int dtg, TreeVisitor V, CastlingRights cr, MaterialMask mat>
+static inline NodeCount count_onto(BitBoard pieces, BitBoard to_mask, bool capture, Position& pos) {
+	NodeCount ret = 0;
+	while (pieces) {
+		Square from = pop(pieces);
+		ret += capture ? count_captures<white, p, dtg, V, cr, mat>(to_mask, from, pos)
+					   : count_plain<white, p, dtg, V, cr, mat>(to_mask, from, pos);
+	}
+	return ret;
+}
+
+// Count the pawn pushes or captures onto one square, four promotions each on the last rank.
+template <bool white, int dtg, TreeVisitor V, CastlingRights cr, MaterialMask mat>
+static inline NodeCount count_pawns_onto(BitBoard pawns, Square to, bool capture, Position& pos) {
+	if (!pawns) return 0;
+	// All pawns reaching a square come from the same rank.
+	bool promotion = pawns & (white ? promotion_from_w : promotion_from_b);
+	if constexpr (dtg <= 1 && V::bulk) {
+		return popcnt(pawns) * (promotion ? 4 : 1);
+	} else {
+		if (!promotion) return count_onto<white, PAWN, dtg, V, cr, mat>(pawns, square_to_mask(to), capture, pos);
+		NodeCount ret = 0;
+		const Piece captured = pos.board.get_piece<!white>(to);
+		while (pawns) {
+			Square from = pop(pawns);
+			ret += make_promotion<white, QUEEN, dtg, V, cr, mat>(from, to, captured, pos);
+			ret += make_promotion<white, ROOK, dtg, V, cr, mat>(from, to, captured, pos);
+			ret += make_promotion<white, BISHOP, dtg, V, cr, mat>(from, to, captured, pos);
+			ret += make_promotion<white, KNIGHT, dtg, V, cr, mat>(from, to, captured, pos);
+		}
+		return ret;
+	}
+}
+
+// Non-king moves out of a single check: captures of the checker and interpositions on the checking ray. Pinned pieces
+// can never resolve a check, so for each square of the check mask the unpinned pieces reaching it are looked up from
+// the square backwards, and only their moves onto it are counted. En passant is left to generate_ep_moves.
+template <bool white, int dtg, TreeVisitor V, CastlingRights cr, MaterialMask mat>
+static inline NodeCount generate_evasions(Position& pos, MaskSet& msk) {
+	Board& b = pos.board;
+	BitBoard occ = b.occ_board;
+	BitBoard knights = b.get_piece_board<white, KNIGHT>() & msk.nopin;
+	BitBoard bishops = b.get_piece_board<white, BISHOP>() & msk.nopin;
+	BitBoard rooks = b.get_piece_board<white, ROOK>() & msk.nopin;
+	BitBoard queens = b.get_piece_board<white, QUEEN>() & msk.nopin;
+	BitBoard pawns = b.get_piece_board<white, PAWN>() & msk.nopin;
+	BitBoard diag = bishops | queens;
+	BitBoard orth = rooks | queens;
+	BitBoard targets = msk.cmt;
+	NodeCount ret = 0;
+
+	while (targets) {
+		Square to = pop(targets);
+		BitBoard to_mask = square_to_mask(to);
+		bool capture = to_mask & occ;
+		BitBoard knight_from = knights ? get_knight_move(to) & knights : 0;
+		BitBoard diag_from = 0, orth_from = 0, pawn_from = 0, double_from = 0;
+		if constexpr (has_sliders<white>(mat)) {
+			if (diag) diag_from = get_bishop_move(to, occ) & diag;
+			if (orth) orth_from = get_rook_move(to, occ) & orth;
+		}
+		if constexpr (has_pawns(mat)) {
+			if (capture) {
+				pawn_from = get_pawn_attacks<!white>(to_mask) & pawns;
+			} else {
+				BitBoard behind = get_pawn_forward<!white>(to_mask);
+				pawn_from = behind & pawns;
+				double_from = get_pawn_forward<!white>(behind & ~occ) & pawns & (white ? pawn_start_w : pawn_start_b);
+			}
+		}
+
+		if constexpr (dtg <= 1 && V::bulk) {
+			ret += popcnt(knight_from | diag_from | orth_from | double_from);
+		} else {
+			ret += count_onto<white, KNIGHT, dtg, V, cr, mat>(knight_from, to_mask, capture, pos);
+			ret += count_onto<white, BISHOP, dtg, V, cr, mat>(diag_from & bishops, to_mask, capture, pos);
+			ret += count_onto<white, ROOK, dtg, V, cr, mat>(orth_from & rooks, to_mask, capture, pos);
+			ret += count_onto<white, QUEEN, dtg, V, cr, mat>((diag_from | orth_from) & queens, to_mask, capture, pos);
+			if (double_from) ret += generate_pawn_double<white, dtg, V, cr, mat>(to_mask, pos, double_from);
+		}
+		ret += count_pawns_onto<white, dtg, V, cr, mat>(pawn_from, to, capture, pos);
+	}
+	return ret;
+}
+
+// Whether looking the pieces up from the squares of the check mask takes fewer table lookups than generating the moves
+// of each unpinned piece and masking them with it. Captures of a contact, knight or pawn checker have one square to
+// look up from, while a long checking ray in a position with few pieces is cheaper to intersect.
+template <bool white, MaterialMask mat>
+static inline bool evasion_lookups_pay(Board& b, MaskSet& msk) {
+	BitBoard knights = b.get_piece_board<white, KNIGHT>() & msk.nopin;
+	int kinds = knights != 0, pieces = popcnt(knights);
+	if constexpr (has_sliders<white>(mat)) {
+		BitBoard queens = b.get_piece_board<white, QUEEN>() & msk.nopin;
+		BitBoard bishops = b.get_piece_board<white, BISHOP>() & msk.nopin;
+		BitBoard rooks = b.get_piece_board<white, ROOK>() & msk.nopin;
+		kinds += ((bishops | queens) != 0) + ((rooks | queens) != 0);
+		pieces += popcnt(bishops | rooks) + 2 * popcnt(queens);
+	}
+	return popcnt(msk.cmt) * kinds <= pieces;
 }
 
 /*
  *	MAIN
  */
 
-// Main counting function.
-template <bool white, int dtg, bool print_move, CastlingRights cr, bool ep = false>
+// Main counting function, walking the tree with the hooks of V. Generators and probes for piece kinds the signature
+// rules out are compiled out.
+template <bool white, int dtg, TreeVisitor V, CastlingRights cr, MaterialMask mat = all_material, bool ep = false>
 uint64_t count_moves(Position& pos) {
 	if constexpr (dtg < 1)
-		return 1;
+		return V::template leaf<white, cr, ep>(pos);
 	else {
 		uint8_t ep_flag = ep ? pos.ep_flag : 0;
+		V::template enter<white, cr, ep>(pos, dtg);
+
+		// Make masks. With incremental masks, the pins the parent found are taken over where the move left them
+		// unchanged, and the children take the pins of the opponent from the next slot. Leaves make no masks. With
+		// delta leaves, nodes whose children are counted in bulk always do so, and also count the knight and slider
+		// replies once for all children when the opponent has enough pieces for it to pay.
+		constexpr bool delta_parent = delta_leaves && dtg == 2 && V::Child::bulk;
+		constexpr bool delta_child = delta_leaves && dtg == 1 && V::bulk;
+		constexpr bool carry_masks = (incremental_masks && dtg >= 2) || delta_parent;
+		MaskSet& msk = incremental_masks || delta_child
+			? create_masks_after<white, mat>(pos.board, pos.get_ksq<white>(), pos.masks.go_next())
+			: create_masks<white, mat>(pos.board, pos.get_ksq<white>(), pos.masks.go_next());
+		if constexpr (delta_parent) pos.replies.valid = reply_counts_pay<white>(pos.board);
+		if (carry_masks && (incremental_masks || pos.replies.valid)) {
+			prepare_child_masks<white, mat>(pos.board, pos.get_ksq<!white>(), pos.masks.top());
+			if constexpr (delta_parent)
+				if (pos.replies.valid) prepare_reply_counts<white, mat>(pos.board, pos.masks.top(), pos.replies);
+		}
 
-		// Make masks.
-		MaskSet& msk = create_masks<white>(pos.board, pos.get_ksq<white>(), pos.masks.go_next());
-
-		// King moves can always be generated.
-		uint64_t ret = generate_king_moves<white, dtg, print_move, cr>(msk.cmt, pos);
+		// King moves can always be generated. They and castling are tested against one map of the attacked squares,
+		// made for the squares the king could go to.
+		BitBoard king_targets = msk.cmt & get_king_move(pos.get_ksq<white>());
+		BitBoard danger = pos.king_danger<white, mat>(king_targets | (msk.checkers ? 0 : castle_squares<white, cr>()));
+		uint64_t ret = generate_king_moves<white, dtg, V, cr, mat>(msk.cmt, danger, pos);
 
 		// If double check, only king can move. Else, limit the target squares to the checkmask and skip castling.
 		switch (msk.checkers) {
 		case 0:
-			ret += generate_castle_move<white, true, dtg, print_move, cr>(pos);
-			ret += generate_castle_move<white, false, dtg, print_move, cr>(pos);
+			ret += generate_castle_move<white, true, dtg, V, cr, mat>(danger, pos);
+			ret += generate_castle_move<white, false, dtg, V, cr, mat>(danger, pos);
 			break;
 		case 1:
 			msk.cmt &= msk.check_mask;
 			break;
 		default:
+			if constexpr (carry_masks) pos.masks.top().lines_valid = false;
+			pos.masks.point_prev();
+			V::template leave<white, cr, ep>(pos, dtg, ret);
 			return ret;
 		}
 
-		// Generate moves.
-		ret += generate_sliders<white, dtg, print_move, cr>(pos, msk);
-		ret += generate_pawn<white, dtg, print_move, cr>(pos, msk);
-		ret += generate_knight<white, dtg, print_move, cr>(pos, msk);
-		if constexpr (ep) ret += generate_ep_moves<white, dtg, print_move, cr>(pos, ep_flag, msk);
+		// Without check, ep or a change of pins, the knight and slider moves are the parent's reply counts, corrected
+		// for the pieces the move touched.
+		bool counted_ahead = false;
+		if constexpr (delta_child && !ep)
+			counted_ahead = msk.lines_valid && pos.replies.valid && !msk.checkers
+				&& msk.pinmask_dg == msk.line_pins_dg && msk.pinmask_orth == msk.line_pins_orth;
+
+		// Generate moves. In check the pieces reaching the check mask are looked up from it when that is cheaper.
+		if (msk.checkers && evasion_lookups_pay<white, mat>(pos.board, msk)) {
+			ret += generate_evasions<white, dtg, V, cr, mat>(pos, msk);
+		} else {
+			if (counted_ahead) {
+				NodeCount replies = count_replies<white>(pos.board, msk, pos.replies);
+#ifdef PYKE_CHECK_MASKS
+				NodeCount generated = generate_sliders<white, dtg, V, cr, mat>(pos, msk);
+				if (replies != generated + generate_knight<white, dtg, V, cr, mat>(pos, msk))
+					throw std::logic_error("count_replies differs from the generators");
+#endif
+				ret += replies;
+			} else if constexpr (has_sliders<white>(mat)) {
+				ret += generate_sliders<white, dtg, V, cr, mat>(pos, msk);
+			}
+			if constexpr (has_pawns(mat)) ret += generate_pawn<white, dtg, V, cr, mat>(pos, msk);
+			if (!counted_ahead) ret += generate_knight<white, dtg, V, cr, mat>(pos, msk);
+		}
+		if constexpr (ep && has_pawns(mat)) ret += generate_ep_moves<white, dtg, V, cr, mat>(pos, ep_flag);
+		if constexpr (carry_masks) pos.masks.top().lines_valid = false;
 		pos.masks.point_prev();
+		V::template leave<white, cr, ep>(pos, dtg, ret);
 		return ret;
 	}
 }
 
+/*
+ *	TERMINAL
+ */
+
+// Whether any of the given pieces can reach a square in cmt.
+template <bool white, Piece p>
+static inline bool has_piece_move(BitBoard cmt, BitBoard pieces, Position& pos) {
+	if (!cmt) return false;
+	while (pieces) {
+		if (cmt & make_reach_board<white, p>(pop(pieces), pos.board)) return true;
+	}
+	return false;
+}
+
+// Whether any of the given pawns has a push, double push or capture onto a square in cmt.
+template <bool white>
+static inline bool has_pawn_move(BitBoard cmt, BitBoard pawns, BitBoard occ) {
+	if (!(cmt && pawns)) return false;
+	BitBoard single = get_pawn_forward<white>(pawns) & ~occ;
+	BitBoard on_start = pawns & (white ? pawn_start_w : pawn_start_b);
+	return (single & cmt) || (get_pawn_double<white>(on_start, occ) & cmt)
+		|| (get_pawn_left<white>(can_capture_left(pawns)) & cmt & occ)
+		|| (get_pawn_right<white>(can_capture_right(pawns)) & cmt & occ);
+}
+
+// Whether an ep capture leaves the own king safe. Offset is whether ep comes from left or right.
+template <bool white, int offset>
+static inline bool has_ep_move(Position& pos, uint8_t ep) {
+	sq_pair epsq = get_ep_squares<white, offset>(ep);
+	BitBoard move = square_to_mask(epsq.first) | square_to_mask(epsq.second);
+	BitBoard capture_sq = square_to_mask(white ? epsq.second + 8 : epsq.second - 8);
+
+	ep_move<white>(pos.board, move, capture_sq);
+	bool legal = !pos.is_attacked<white>(pos.get_ksq<white>());
+	unmake_ep_move<white>(pos.board, move, capture_sq);
+	return legal;
+}
+
+// Returns whether the side to move has at least one legal move. Generators are tried in order of likelihood, king
+// first and then from most to least mobile piece, and the search stops at the first legal move. Castling never has to
+// be checked: when it is legal, the king step onto the middle square is legal as well.
+template <bool white, bool ep = false>
+bool has_legal_move(Position& pos) {
+	Board& b = pos.board;
+	Square ksq = pos.get_ksq<white>();
+	MaskSet msk;
+	create_masks<white>(b, ksq, msk);
+
+	// King moves. The king is lifted from the occupancy so it can not hide behind itself on a checking ray.
+	BitBoard king_to = get_king_move(ksq) & msk.cmt;
+	b.occ_board ^= square_to_mask(ksq);
+	while (king_to) {
+		if (!pos.is_attacked<white>(pop(king_to))) {
+			b.occ_board ^= square_to_mask(ksq);
+			return true;
+		}
+	}
+	b.occ_board ^= square_to_mask(ksq);
+
+	switch (msk.checkers) {
+	case 0:
+		break;
+	case 1:
+		msk.cmt &= msk.check_mask;
+		break;
+	default:
+		return false;
+	}
+
+	BitBoard queens = pos.piece_brd<white, QUEEN>();
+	BitBoard rooks = pos.piece_brd<white, ROOK>();
+	BitBoard bishops = pos.piece_brd<white, BISHOP>();
+	BitBoard pawns = pos.piece_brd<white, PAWN>();
+	BitBoard pin_cmt_diag = msk.cmt & msk.pinmask_dg;
+	BitBoard pin_cmt_orth = msk.cmt & msk.pinmask_orth;
+	BitBoard dg_not_orth = msk.pinmask_dg & ~msk.pinmask_orth;
+	BitBoard orth_not_dg = msk.pinmask_orth & ~msk.pinmask_dg;
+
+	// Unpinned pieces first, pinned pieces can only move along their pin ray.
+	if (has_piece_move<white, QUEEN>(msk.cmt, queens & msk.nopin, pos)) return true;
+	if (has_piece_move<white, ROOK>(msk.cmt, rooks & msk.nopin, pos)) return true;
+	if (has_piece_move<white, BISHOP>(msk.cmt, bishops & msk.nopin, pos)) return true;
+	if (has_piece_move<white, KNIGHT>(msk.cmt, pos.piece_brd<white, KNIGHT>() & msk.nopin, pos)) return true;
+	if (has_pawn_move<white>(msk.cmt, pawns & msk.nopin, b.occ_board)) return true;
+	if (has_piece_move<white, QUEEN_DIAG>(pin_cmt_diag, queens & dg_not_orth, pos)) return true;
+	if (has_piece_move<white, QUEEN_ORTH>(pin_cmt_orth, queens & orth_not_dg, pos)) return true;
+	if (has_piece_move<white, ROOK>(pin_cmt_orth, rooks & orth_not_dg, pos)) return true;
+	if (has_piece_move<white, BISHOP>(pin_cmt_diag, bishops & dg_not_orth, pos)) return true;
+	if (has_pawn_move<white>(pin_cmt_diag, pawns & msk.pinmask_dg, b.occ_board)) return true;
+	if (has_pawn_move<white>(pin_cmt_orth, pawns & msk.pinmask_orth, b.occ_board)) return true;
+
+	if constexpr (ep) {
+		uint8_t ep_flag = pos.ep_flag;
+		return (ep_flag & 0x80 && has_ep_move<white, -1>(pos, ep_flag))
+			|| (ep_flag & 0x40 && has_ep_move<white, 1>(pos, ep_flag));
+	}
+	return false;
+}
+
+// Checkmate or stalemate detection for the side to move, built on the early exit legal move check.
+template <bool white, bool ep = false>
+GameResult game_result(Position& pos) {
+	if (has_legal_move<white, ep>(pos)) return GameResult::ONGOING;
+	return pos.is_attacked<white>(pos.get_ksq<white>()) ? GameResult::CHECKMATE : GameResult::STALEMATE;
+}
+
+// Runtime wrapper. Uses the side to move and ep flag stored in the position.
+inline GameResult game_result(Position& pos) {
+	if (pos.white_turn)
+		return pos.ep_flag ? game_result<true, true>(pos) : game_result<true, false>(pos);
+	else
+		return pos.ep_flag ? game_result<false, true>(pos) : game_result<false, false>(pos);
+}
+
 };	// namespace pyke
 
 #endif
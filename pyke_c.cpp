@@ -0,0 +1,79 @@
+#include "pyke_c.h"
+
+#include <memory>
+#include <mutex>
+
+#include "perft.hpp"
+#include "thread_pool.hpp"
+
+// Batch pool, created on demand by pyke_set_threads. Batches run inline while it is not set.
+static std::unique_ptr<ThreadPool> batch_pool;
+static std::mutex batch_mutex;
+
+static uint64_t perft_fen(const char* fen, int depth) {
+	if (!fen || depth < 0 || depth > 10) return PYKE_ERROR;
+	try {
+		Position pos;
+		pos.load_fen(fen);
+		return count_root(pos, depth);
+	} catch (...) {
+		return PYKE_ERROR;
+	}
+}
+
+// Runs f over the batch, on the pool if one is configured.
+template <typename F>
+static int run_batch(int n, uint64_t* out, F f) {
+	if (n <= 0 || !out) return 0;
+	std::lock_guard<std::mutex> lock(batch_mutex);
+	if (batch_pool)
+		batch_pool->parallel_for(n, [&](size_t i, unsigned) { out[i] = f(i); });
+	else
+		for (int i = 0; i < n; i++) out[i] = f(i);
+
+	int failed = 0;
+	for (int i = 0; i < n; i++) failed += out[i] == PYKE_ERROR;
+	return failed;
+}
+
+extern "C" {
+
+int pyke_api_version(void) { return PYKE_API_VERSION; }
+
+void pyke_set_threads(int threads) {
+	std::lock_guard<std::mutex> lock(batch_mutex);
+	batch_pool = threads > 1 ? std::make_unique<ThreadPool>(threads) : nullptr;
+}
+
+uint64_t pyke_perft(const char* fen, int depth) { return perft_fen(fen, depth); }
+
+uint64_t pyke_count_legal(const char* fen) { return perft_fen(fen, 1); }
+
+int pyke_game_result(const char* fen) {
+	if (!fen) return -1;
+	try {
+		Position pos;
+		pos.load_fen(fen);
+		switch (pyke::game_result(pos)) {
+		case GameResult::CHECKMATE:
+			return PYKE_CHECKMATE;
+		case GameResult::STALEMATE:
+			return PYKE_STALEMATE;
+		default:
+			return PYKE_ONGOING;
+		}
+	} catch (...) {
+		return -1;
+	}
+}
+
+int pyke_perft_batch(const char** fens, int n, int depth, uint64_t* out) {
+	if (!fens) return n;
+	return run_batch(n, out, [&](size_t i) { return perft_fen(fens[i], depth); });
+}
+
+int pyke_count_legal_batch(const char** fens, int n, uint64_t* out) {
+	if (!fens) return n;
+	return run_batch(n, out, [&](size_t i) { return perft_fen(fens[i], 1); });
+}
+}
@@ -0,0 +1,52 @@
+/* C interface of libpyke. Only plain C types cross this boundary, so it can be bound from Python (ctypes/cffi),
+ * Go (cgo) and other FFI layers. Functions never throw; invalid input is reported through return values. */
+
+#ifndef PYKE_C_H
+#define PYKE_C_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define PYKE_EXPORT __attribute__((visibility("default")))
+#else
+#define PYKE_EXPORT
+#endif
+
+/* Bumped whenever a signature or behaviour of this interface changes. */
+#define PYKE_API_VERSION 1
+
+/* Written to an output slot when its position could not be processed. */
+#define PYKE_ERROR UINT64_MAX
+
+/* Game results returned by pyke_game_result, for the side to move. */
+#define PYKE_ONGOING   0
+#define PYKE_CHECKMATE 1
+#define PYKE_STALEMATE 2
+
+PYKE_EXPORT int pyke_api_version(void);
+
+/* Sets the number of threads used by the batch functions. 1 (the default) runs batches on the calling thread. */
+PYKE_EXPORT void pyke_set_threads(int threads);
+
+/* Perft node count of a FEN at depth 0 to 10. Returns PYKE_ERROR on a malformed FEN or unsupported depth. */
+PYKE_EXPORT uint64_t pyke_perft(const char* fen, int depth);
+
+/* Number of legal moves in a FEN, or PYKE_ERROR. */
+PYKE_EXPORT uint64_t pyke_count_legal(const char* fen);
+
+/* Game result of a FEN, or -1 on a malformed FEN. */
+PYKE_EXPORT int pyke_game_result(const char* fen);
+
+/* Batch versions: out[i] receives the result for fens[i]. Return the number of positions that failed. */
+PYKE_EXPORT int pyke_perft_batch(const char** fens, int n, int depth, uint64_t* out);
+PYKE_EXPORT int pyke_count_legal_batch(const char** fens, int n, uint64_t* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
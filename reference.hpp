@@ -0,0 +1,287 @@
+#include <cctype>
+#include <cstdint>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "defaults.hpp"
+#include "gamestate.hpp"
+#include "util.hpp"
+
+#ifndef REFERENCE_H
+#define REFERENCE_H
+
+// Slow mailbox move generator, used as an oracle for the bitboard generator in pyke.hpp. It only shares the square
+// numbering (0 is a8, 63 is h1) and the castling rights layout with the optimized code, so a bug in one of them does
+// not hide in the other. Moves are generated pseudo legal and filtered by making them on a copy.
+
+struct RefMove {
+	Square from;
+	Square to;
+	Piece promotion = EMPTY;
+
+	// Long algebraic notation, as printed by the divide output of count_moves.
+	std::string to_string() const {
+		constexpr char promotion_chars[] = " pkrbnq";
+		std::string ret = make_chess_notation(from) + make_chess_notation(to);
+		if (promotion != EMPTY) ret += promotion_chars[promotion];
+		return ret;
+	}
+};
+
+struct RefPosition {
+	Piece pieces[64] = {};
+	bool white[64] = {};
+	bool white_turn = true;
+	CastlingRights castling_rights = 0;
+	int ep_square = -1;
+
+	void load_fen(const std::string& fen) {
+		std::istringstream in(fen);
+		std::string placement, side, castling = "-", ep = "-";
+		if (!(in >> placement >> side)) throw std::invalid_argument("FEN is missing fields: " + fen);
+		in >> castling >> ep;
+
+		int s = 0;
+		for (char c : placement) {
+			if (c == '/') continue;
+			if (std::isdigit(c)) {
+				for (int i = 0; i < c - '0' && s < 64; i++, s++) pieces[s] = EMPTY;
+				continue;
+			}
+			if (s > 63) throw std::invalid_argument("FEN placement overflows the board: " + fen);
+			white[s] = std::isupper(c);
+			pieces[s++] = piece_from_char(std::tolower(c));
+		}
+		if (s != 64) throw std::invalid_argument("FEN does not describe a full board: " + fen);
+
+		white_turn = side != "b";
+		castling_rights = make_cr_flag(
+			castling.find('k') != std::string::npos, castling.find('q') != std::string::npos,
+			castling.find('K') != std::string::npos, castling.find('Q') != std::string::npos
+		);
+		ep_square = ep.size() == 2 ? notation_to_square(ep) : -1;
+	}
+
+	std::string fen() const {
+		std::string ret;
+		for (int row = 0; row < 8; row++) {
+			int empty = 0;
+			for (int col = 0; col < 8; col++) {
+				int s = row * 8 + col;
+				if (pieces[s] == EMPTY) {
+					empty++;
+					continue;
+				}
+				if (empty) ret += char('0' + empty);
+				empty = 0;
+				char c = " pkrbnq"[pieces[s]];
+				ret += white[s] ? char(std::toupper(c)) : c;
+			}
+			if (empty) ret += char('0' + empty);
+			if (row < 7) ret += '/';
+		}
+		ret += white_turn ? " w " : " b ";
+		std::string castling;
+		if (get_cr_wk(castling_rights)) castling += 'K';
+		if (get_cr_wq(castling_rights)) castling += 'Q';
+		if (get_cr_bk(castling_rights)) castling += 'k';
+		if (get_cr_bq(castling_rights)) castling += 'q';
+		ret += castling.empty() ? "-" : castling;
+		ret += ' ' + (ep_square >= 0 ? make_chess_notation(ep_square) : std::string("-"));
+		return ret + " 0 1";
+	}
+
+	// Whether a square is attacked by the given color.
+	bool attacked(int s, bool by_white) const {
+		int row = s / 8, col = s % 8;
+		auto is = [&](int r, int c, Piece p) {
+			return on_board(r, c) && pieces[r * 8 + c] == p && white[r * 8 + c] == by_white;
+		};
+
+		// White pawns attack towards row 0, so they sit one row further from it.
+		int pawn_row = by_white ? row + 1 : row - 1;
+		if (is(pawn_row, col - 1, PAWN) || is(pawn_row, col + 1, PAWN)) return true;
+		for (auto [dr, dc] : knight_steps)
+			if (is(row + dr, col + dc, KNIGHT)) return true;
+		for (auto [dr, dc] : king_steps)
+			if (is(row + dr, col + dc, KING)) return true;
+		for (int d = 0; d < 8; d++) {
+			auto [dr, dc] = king_steps[d];
+			bool diagonal = dr && dc;
+			for (int r = row + dr, c = col + dc; on_board(r, c); r += dr, c += dc) {
+				Piece p = pieces[r * 8 + c];
+				if (p == EMPTY) continue;
+				if (white[r * 8 + c] == by_white && (p == QUEEN || p == (diagonal ? BISHOP : ROOK))) return true;
+				break;
+			}
+		}
+		return false;
+	}
+
+	bool in_check() const {
+		for (int s = 0; s < 64; s++)
+			if (pieces[s] == KING && white[s] == white_turn) return attacked(s, !white_turn);
+		return false;
+	}
+
+	std::vector<RefMove> legal_moves() const {
+		std::vector<RefMove> ret;
+		for (const RefMove& m : pseudo_legal_moves()) {
+			RefPosition next = make(m);
+			next.white_turn = white_turn;
+			if (!next.in_check()) ret.push_back(m);
+		}
+		return ret;
+	}
+
+	// Returns the position after the move. The move is assumed to come from pseudo_legal_moves.
+	RefPosition make(const RefMove& m) const {
+		RefPosition ret = *this;
+		Piece p = pieces[m.from];
+		int from_col = m.from % 8, to_col = m.to % 8;
+
+		if (p == PAWN && m.to == ep_square) ret.pieces[m.from / 8 * 8 + to_col] = EMPTY;
+		ret.pieces[m.to] = m.promotion != EMPTY ? m.promotion : p;
+		ret.white[m.to] = white_turn;
+		ret.pieces[m.from] = EMPTY;
+
+		// Castling moves the rook as well.
+		if (p == KING && (to_col - from_col == 2 || from_col - to_col == 2)) {
+			int rook_from = to_col == 6 ? m.from + 3 : m.from - 4;
+			int rook_to = to_col == 6 ? m.from + 1 : m.from - 1;
+			ret.pieces[rook_to] = ROOK;
+			ret.white[rook_to] = white_turn;
+			ret.pieces[rook_from] = EMPTY;
+		}
+
+		// Any move from or to a king or rook start square drops the matching rights.
+		for (int s : {int(m.from), int(m.to)}) {
+			if (s == 60) ret.castling_rights = rm_cr_w(ret.castling_rights);
+			if (s == 4) ret.castling_rights = rm_cr_b(ret.castling_rights);
+			if (s == 63) ret.castling_rights = rm_cr_wk(ret.castling_rights);
+			if (s == 56) ret.castling_rights = rm_cr_wq(ret.castling_rights);
+			if (s == 7) ret.castling_rights = rm_cr_bk(ret.castling_rights);
+			if (s == 0) ret.castling_rights = rm_cr_bq(ret.castling_rights);
+		}
+
+		int distance = int(m.to) - int(m.from);
+		ret.ep_square = p == PAWN && (distance == 16 || distance == -16) ? (m.from + m.to) / 2 : -1;
+		ret.white_turn = !white_turn;
+		return ret;
+	}
+
+private:
+	static constexpr std::pair<int, int> knight_steps[8] = {{-2, -1}, {-2, 1}, {-1, -2}, {-1, 2},
+															 {1, -2},  {1, 2},	{2, -1},  {2, 1}};
+	static constexpr std::pair<int, int> king_steps[8] = {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1},
+														   {0, 1},	 {1, -1}, {1, 0},  {1, 1}};
+
+	static bool on_board(int r, int c) { return r >= 0 && r < 8 && c >= 0 && c < 8; }
+
+	static Piece piece_from_char(char c) {
+		switch (c) {
+		case 'p':
+			return PAWN;
+		case 'n':
+			return KNIGHT;
+		case 'b':
+			return BISHOP;
+		case 'r':
+			return ROOK;
+		case 'q':
+			return QUEEN;
+		case 'k':
+			return KING;
+		}
+		throw std::invalid_argument(std::string("Unknown piece in FEN: ") + c);
+	}
+
+	bool own(int r, int c) const { return pieces[r * 8 + c] != EMPTY && white[r * 8 + c] == white_turn; }
+	bool enemy(int r, int c) const { return pieces[r * 8 + c] != EMPTY && white[r * 8 + c] != white_turn; }
+
+	std::vector<RefMove> pseudo_legal_moves() const {
+		std::vector<RefMove> ret;
+		auto add = [&](int from, int to) { ret.push_back({Square(from), Square(to)}); };
+
+		for (int s = 0; s < 64; s++) {
+			if (pieces[s] == EMPTY || white[s] != white_turn) continue;
+			int row = s / 8, col = s % 8;
+
+			switch (pieces[s]) {
+			case PAWN: {
+				int dir = white_turn ? -1 : 1;
+				int start_row = white_turn ? 6 : 1;
+				int promo_row = white_turn ? 0 : 7;
+				auto add_pawn = [&](int to) {
+					if (to / 8 != promo_row) return add(s, to);
+					for (Piece p : promotion_pieces) ret.push_back({Square(s), Square(to), p});
+				};
+				int r = row + dir;
+				if (pieces[r * 8 + col] == EMPTY) {
+					add_pawn(r * 8 + col);
+					if (row == start_row && pieces[(r + dir) * 8 + col] == EMPTY) add(s, (r + dir) * 8 + col);
+				}
+				for (int c : {col - 1, col + 1}) {
+					if (!on_board(r, c)) continue;
+					if (enemy(r, c) || r * 8 + c == ep_square) add_pawn(r * 8 + c);
+				}
+				break;
+			}
+			case KNIGHT:
+			case KING:
+				for (int d = 0; d < 8; d++) {
+					auto [dr, dc] = pieces[s] == KNIGHT ? knight_steps[d] : king_steps[d];
+					int r = row + dr, c = col + dc;
+					if (on_board(r, c) && !own(r, c)) add(s, r * 8 + c);
+				}
+				break;
+			default:
+				for (auto [dr, dc] : king_steps) {
+					bool diagonal = dr && dc;
+					if ((pieces[s] == BISHOP && !diagonal) || (pieces[s] == ROOK && diagonal)) continue;
+					for (int r = row + dr, c = col + dc; on_board(r, c) && !own(r, c); r += dr, c += dc) {
+						add(s, r * 8 + c);
+						if (enemy(r, c)) break;
+					}
+				}
+			}
+		}
+
+		// Castling: rights, empty squares between king and rook, and no attacked square on the king's path.
+		int ksq = white_turn ? 60 : 4;
+		bool kingside = white_turn ? get_cr_wk(castling_rights) : get_cr_bk(castling_rights);
+		bool queenside = white_turn ? get_cr_wq(castling_rights) : get_cr_bq(castling_rights);
+		auto empty = [&](int s) { return pieces[s] == EMPTY; };
+		auto safe = [&](int s) { return !attacked(s, !white_turn); };
+		if (pieces[ksq] == KING && white[ksq] == white_turn && safe(ksq)) {
+			if (kingside && empty(ksq + 1) && empty(ksq + 2) && safe(ksq + 1) && safe(ksq + 2)) add(ksq, ksq + 2);
+			if (queenside && empty(ksq - 1) && empty(ksq - 2) && empty(ksq - 3) && safe(ksq - 1) && safe(ksq - 2))
+				add(ksq, ksq - 2);
+		}
+		return ret;
+	}
+};
+
+static uint64_t ref_perft(const RefPosition& pos, int depth) {
+	if (depth == 0) return 1;
+	std::vector<RefMove> moves = pos.legal_moves();
+	if (depth == 1) return moves.size();
+	uint64_t ret = 0;
+	for (const RefMove& m : moves) ret += ref_perft(pos.make(m), depth - 1);
+	return ret;
+}
+
+// Node count per root move. Moves without nodes are left out, matching the divide output of count_moves.
+static std::map<std::string, uint64_t> ref_divide(const RefPosition& pos, int depth) {
+	std::map<std::string, uint64_t> ret;
+	for (const RefMove& m : pos.legal_moves()) {
+		uint64_t cnt = ref_perft(pos.make(m), depth - 1);
+		if (cnt) ret[m.to_string()] = cnt;
+	}
+	return ret;
+}
+
+#endif
@@ -0,0 +1,114 @@
+#include <cstdint>
+
+#include "board.hpp"
+#include "defaults.hpp"
+#include "maskset.hpp"
+#include "material.hpp"
+#include "piece_moves.hpp"
+
+#ifndef REPLY_COUNTS_H
+#define REPLY_COUNTS_H
+
+// Whether nodes two plies above the leaves count the knight and slider replies of the opponent once, so that each
+// child only recounts the pieces its move touched, set off with the PYKE_NO_DELTA_LEAVES build option.
+#ifdef PYKE_NO_DELTA_LEAVES
+inline constexpr bool delta_leaves = false;
+#else
+inline constexpr bool delta_leaves = true;
+#endif
+
+// A knight or slider of the side replying, with the squares it reaches on the parent's board and the moves among them.
+// kind is KNIGHT, BISHOP, ROOK or QUEEN, a pinned queen moving as a bishop or rook. Pinned pieces are limited to their
+// pin rays by restrict_to, touch is the reach plus the own square.
+struct ReplyPiece {
+	BitBoard touch;
+	BitBoard restrict_to;
+	Square square;
+	uint8_t kind;
+	uint8_t count;
+};
+
+struct ReplyCounts {
+	ReplyPiece pieces[16];
+	uint8_t size = 0;
+	NodeCount total = 0;
+	bool valid = false;
+};
+
+// With few pieces, most moves touch the reach of one of them and the lookups saved in the children do not make up for
+// finding the changed squares, so the replies are only counted ahead from this many knights and sliders on.
+static constexpr int reply_counts_min_pieces = 4;
+
+template <bool white>
+static inline bool reply_counts_pay(Board& b) {
+	return popcnt(b.get_piece_board<!white, KNIGHT>() | b.get_piece_board<!white, BISHOP>()
+				  | b.get_piece_board<!white, ROOK>() | b.get_piece_board<!white, QUEEN>())
+		>= reply_counts_min_pieces;
+}
+
+static inline BitBoard reply_reach(uint8_t kind, Square square, BitBoard occ) {
+	switch (kind) {
+	case KNIGHT:
+		return get_knight_move(square);
+	case BISHOP:
+		return get_bishop_move(square, occ);
+	case ROOK:
+		return get_rook_move(square, occ);
+	default:
+		return get_queen_move(square, occ);
+	}
+}
+
+static inline void add_reply_pieces(ReplyCounts& r, BitBoard pieces, uint8_t kind, BitBoard restrict_to, Board& b,
+									BitBoard cmt) {
+	while (pieces) {
+		Square square = pop(pieces);
+		BitBoard reach = reply_reach(kind, square, b.occ_board);
+		uint8_t count = popcnt(reach & restrict_to & cmt);
+		r.pieces[r.size++] = {reach | square_to_mask(square), restrict_to, square, kind, count};
+		r.total += count;
+	}
+}
+
+// Counts the knight and slider moves of the side not to move, split the way generate_sliders and generate_knight split
+// them, using the pins prepare_child_masks stored in next.
+template <bool white, MaterialMask mat = all_material>
+void prepare_reply_counts(Board& b, MaskSet& next, ReplyCounts& r) {
+	BitBoard cmt = ~b.get_player_occ<!white>();
+	BitBoard nopin = ~(next.line_pins_dg | next.line_pins_orth);
+	r.size = 0;
+	r.total = 0;
+	add_reply_pieces(r, b.get_piece_board<!white, KNIGHT>() & nopin, KNIGHT, ~0ULL, b, cmt);
+	if constexpr (has_sliders<!white>(mat)) {
+		BitBoard bishops = b.get_piece_board<!white, BISHOP>();
+		BitBoard rooks = b.get_piece_board<!white, ROOK>();
+		BitBoard queens = b.get_piece_board<!white, QUEEN>();
+		BitBoard dg_not_orth = next.line_pins_dg & ~next.line_pins_orth;
+		BitBoard orth_not_dg = next.line_pins_orth & ~next.line_pins_dg;
+		add_reply_pieces(r, bishops & nopin, BISHOP, ~0ULL, b, cmt);
+		add_reply_pieces(r, rooks & nopin, ROOK, ~0ULL, b, cmt);
+		add_reply_pieces(r, queens & nopin, QUEEN, ~0ULL, b, cmt);
+		add_reply_pieces(r, (bishops | queens) & dg_not_orth, BISHOP, next.line_pins_dg, b, cmt);
+		add_reply_pieces(r, (rooks | queens) & orth_not_dg, ROOK, next.line_pins_orth, b, cmt);
+	}
+}
+
+// The knight and slider moves of the side to move in a child of the node that called prepare_reply_counts, whose masks
+// hold the same pins. Only the pieces whose square or reach holds a square the move changed are counted again, and a
+// captured piece drops out.
+template <bool white>
+static inline NodeCount count_replies(Board& b, MaskSet& msk, const ReplyCounts& r) {
+	BitBoard own = b.get_player_occ<white>();
+	BitBoard changed = (own ^ msk.line_own) | (b.get_player_occ<!white>() ^ msk.line_opp);
+	NodeCount ret = r.total;
+	for (uint8_t i = 0; i < r.size; i++) {
+		const ReplyPiece& p = r.pieces[i];
+		if (!(p.touch & changed)) continue;
+		ret -= p.count;
+		if (own & square_to_mask(p.square))
+			ret += popcnt(reply_reach(p.kind, p.square, b.occ_board) & p.restrict_to & msk.cmt);
+	}
+	return ret;
+}
+
+#endif
@@ -0,0 +1,296 @@
+#include "search.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+#include "movegen.hpp"
+#include "zobrist.hpp"
+
+// Indexed by piece - 1.
+static constexpr int piece_values[6] = {100, 0, 500, 330, 320, 900};
+
+// Piece square tables from white's side, a8 first. Black reads them at the vertically mirrored square.
+static constexpr int8_t piece_square[6][64] = {
+	// Pawn.
+	{
+		  0,   0,   0,   0,   0,   0,   0,   0,
+		 50,  50,  50,  50,  50,  50,  50,  50,
+		 10,  10,  20,  30,  30,  20,  10,  10,
+		  5,   5,  10,  25,  25,  10,   5,   5,
+		  0,   0,   0,  20,  20,   0,   0,   0,
+		  5,  -5, -10,   0,   0, -10,  -5,   5,
+		  5,  10,  10, -20, -20,  10,  10,   5,
+		  0,   0,   0,   0,   0,   0,   0,   0,
+	},
+	// King, middle game.
+	{
+		-30, -40, -40, -50, -50, -40, -40, -30,
+		-30, -40, -40, -50, -50, -40, -40, -30,
+		-30, -40, -40, -50, -50, -40, -40, -30,
+		-30, -40, -40, -50, -50, -40, -40, -30,
+		-20, -30, -30, -40, -40, -30, -30, -20,
+		-10, -20, -20, -20, -20, -20, -20, -10,
+		 20,  20,   0,   0,   0,   0,  20,  20,
+		 20,  30,  10,   0,   0,  10,  30,  20,
+	},
+	// Rook.
+	{
+		  0,   0,   0,   0,   0,   0,   0,   0,
+		  5,  10,  10,  10,  10,  10,  10,   5,
+		 -5,   0,   0,   0,   0,   0,   0,  -5,
+		 -5,   0,   0,   0,   0,   0,   0,  -5,
+		 -5,   0,   0,   0,   0,   0,   0,  -5,
+		 -5,   0,   0,   0,   0,   0,   0,  -5,
+		 -5,   0,   0,   0,   0,   0,   0,  -5,
+		  0,   0,   0,   5,   5,   0,   0,   0,
+	},
+	// Bishop.
+	{
+		-20, -10, -10, -10, -10, -10, -10, -20,
+		-10,   0,   0,   0,   0,   0,   0, -10,
+		-10,   0,   5,  10,  10,   5,   0, -10,
+		-10,   5,   5,  10,  10,   5,   5, -10,
+		-10,   0,  10,  10,  10,  10,   0, -10,
+		-10,  10,  10,  10,  10,  10,  10, -10,
+		-10,   5,   0,   0,   0,   0,   5, -10,
+		-20, -10, -10, -10, -10, -10, -10, -20,
+	},
+	// Knight.
+	{
+		-50, -40, -30, -30, -30, -30, -40, -50,
+		-40, -20,   0,   0,   0,   0, -20, -40,
+		-30,   0,  10,  15,  15,  10,   0, -30,
+		-30,   5,  15,  20,  20,  15,   5, -30,
+		-30,   0,  15,  20,  20,  15,   0, -30,
+		-30,   5,  10,  15,  15,  10,   5, -30,
+		-40, -20,   0,   5,   5,   0, -20, -40,
+		-50, -40, -30, -30, -30, -30, -40, -50,
+	},
+	// Queen.
+	{
+		-20, -10, -10,  -5,  -5, -10, -10, -20,
+		-10,   0,   0,   0,   0,   0,   0, -10,
+		-10,   0,   5,   5,   5,   5,   0, -10,
+		 -5,   0,   5,   5,   5,   5,   0,  -5,
+		  0,   0,   5,   5,   5,   5,   0,  -5,
+		-10,   5,   5,   5,   5,   5,   0, -10,
+		-10,   0,   5,   0,   0,   0,   0, -10,
+		-20, -10, -10,  -5,  -5, -10, -10, -20,
+	},
+};
+
+enum Bound : uint8_t { BOUND_UPPER = 1, BOUND_LOWER = 2, BOUND_EXACT = 3 };
+
+int evaluate(Position& pos) {
+	int score = 0;
+	for (Piece p = PAWN; p <= QUEEN; p++) {
+		BitBoard w = *pos.board.get_board_pointer(true, p);
+		BitBoard b = *pos.board.get_board_pointer(false, p);
+		score += (popcnt(w) - popcnt(b)) * piece_values[p - 1];
+		while (w) score += piece_square[p - 1][pop(w)];
+		while (b) score -= piece_square[p - 1][pop(b) ^ 56];
+	}
+	return pos.white_turn ? score : -score;
+}
+
+static int64_t now_ms() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+}
+
+static inline bool in_check(Position& pos) {
+	return pos.white_turn ? pos.is_attacked<true>(pos.wksq) : pos.is_attacked<false>(pos.bksq);
+}
+
+// Mate scores are stored relative to the node, so they stay valid at other distances from the root.
+static inline int to_tt(int score, int ply) {
+	return score >= score_mate - 1000 ? score + ply : score <= -score_mate + 1000 ? score - ply : score;
+}
+
+static inline int from_tt(int score, int ply) {
+	return score >= score_mate - 1000 ? score - ply : score <= -score_mate + 1000 ? score + ply : score;
+}
+
+// TT move first, then captures by most valuable victim and least valuable attacker, promotions and killers.
+static inline int move_order(Move m, Move tt_move, const Move* killers) {
+	if (m == tt_move) return 1 << 20;
+	int score = 0;
+	if (m.get_captured() != EMPTY)
+		score += (1 << 16) + 16 * piece_values[m.get_captured() - 1] - piece_values[m.get_piece() - 1] / 16;
+	if (m.get_promotion() != EMPTY) score += (1 << 16) + piece_values[m.get_promotion() - 1];
+	if (!score && killers && (m == killers[0] || m == killers[1])) score = 1 << 15;
+	return score;
+}
+
+// Swaps the best ordered move of the remaining ones to index i.
+static inline void pick_move(MoveBuffer& moves, int* order, int i) {
+	int best = i;
+	for (int j = i + 1; j < moves.size(); j++) {
+		if (order[j] > order[best]) best = j;
+	}
+	std::swap(moves[i], moves[best]);
+	std::swap(order[i], order[best]);
+}
+
+Search::Search(size_t tt_mb) : table(std::max<size_t>(1, (tt_mb << 20) / sizeof(TTEntry))) {}
+
+void Search::clear() {
+	std::fill(table.begin(), table.end(), TTEntry());
+	for (auto& k : killers) k[0] = k[1] = Move();
+}
+
+bool Search::time_up() {
+	if (deadline_ms && !(nodes & 2047) && now_ms() >= deadline_ms) stopped = true;
+	return stopped;
+}
+
+int Search::quiesce(Position& pos, int ply, int alpha, int beta) {
+	nodes++;
+	if (time_up()) return 0;
+
+	bool check = in_check(pos);
+	MoveBuffer moves;
+	pyke::generate_legal_moves(pos, moves);
+	if (!moves.size()) return check ? -score_mate + ply : 0;
+	if (ply >= 127) return evaluate(pos);
+
+	// In check every evasion is searched, otherwise only captures and promotions on top of the stand pat score.
+	int best = -score_infinity;
+	if (!check) {
+		best = evaluate(pos);
+		if (best >= beta) return best;
+		alpha = std::max(alpha, best);
+	}
+
+	int order[256];
+	for (int i = 0; i < moves.size(); i++) order[i] = move_order(moves[i], Move(), nullptr);
+	for (int i = 0; i < moves.size(); i++) {
+		pick_move(moves, order, i);
+		Move m = moves[i];
+		if (!check && m.get_captured() == EMPTY && m.get_promotion() == EMPTY) break;
+
+		MoveUndo undo = pyke::make_move(pos, m);
+		int score = -quiesce(pos, ply + 1, -beta, -alpha);
+		pyke::unmake_move(pos, m, undo);
+		if (stopped) return 0;
+
+		best = std::max(best, score);
+		alpha = std::max(alpha, score);
+		if (alpha >= beta) break;
+	}
+	return best;
+}
+
+int Search::negamax(Position& pos, int depth, int ply, int alpha, int beta) {
+	if (depth <= 0 || ply >= 127) return quiesce(pos, ply, alpha, beta);
+	nodes++;
+	if (time_up()) return 0;
+
+	uint64_t key = zobrist_key(pos);
+	if (ply > 0 && std::find(path.begin(), path.end(), key) != path.end()) return 0;
+
+	TTEntry& entry = table[key % table.size()];
+	Move tt_move;
+	if (entry.key == key) {
+		tt_move = entry.move;
+		int score = from_tt(entry.score, ply);
+		if (ply > 0 && entry.depth >= depth
+			&& (entry.bound == BOUND_EXACT || (entry.bound == BOUND_LOWER && score >= beta)
+				|| (entry.bound == BOUND_UPPER && score <= alpha)))
+			return score;
+	}
+
+	MoveBuffer moves;
+	pyke::generate_legal_moves(pos, moves);
+	if (!moves.size()) return in_check(pos) ? -score_mate + ply : 0;
+
+	int order[256];
+	for (int i = 0; i < moves.size(); i++) order[i] = move_order(moves[i], tt_move, killers[ply]);
+
+	int alpha_start = alpha;
+	int best = -score_infinity;
+	Move best_move;
+	path.push_back(key);
+	for (int i = 0; i < moves.size(); i++) {
+		pick_move(moves, order, i);
+		Move m = moves[i];
+		MoveUndo undo = pyke::make_move(pos, m);
+		int score = -negamax(pos, depth - 1, ply + 1, -beta, -alpha);
+		pyke::unmake_move(pos, m, undo);
+		if (stopped) break;
+
+		if (score > best) {
+			best = score;
+			best_move = m;
+			if (!ply) root_best = m;
+		}
+		alpha = std::max(alpha, score);
+		if (alpha >= beta) {
+			if (m.get_captured() == EMPTY && !(m == killers[ply][0])) {
+				killers[ply][1] = killers[ply][0];
+				killers[ply][0] = m;
+			}
+			break;
+		}
+	}
+	path.pop_back();
+	if (stopped) return 0;
+
+	entry.key = key;
+	entry.move = best_move;
+	entry.score = to_tt(best, ply);
+	entry.depth = depth;
+	entry.bound = best <= alpha_start ? BOUND_UPPER : best >= beta ? BOUND_LOWER : BOUND_EXACT;
+	return best;
+}
+
+// Follows the TT moves from the root, as long as they are legal.
+std::vector<Move> Search::principal_variation(Position& pos, int depth) {
+	std::vector<Move> pv;
+	std::vector<MoveUndo> undos;
+	MoveBuffer moves;
+	while ((int)pv.size() < depth) {
+		uint64_t key = zobrist_key(pos);
+		TTEntry& entry = table[key % table.size()];
+		if (entry.key != key || entry.move.is_null()) break;
+		pyke::generate_legal_moves(pos, moves);
+		if (std::find(moves.begin(), moves.end(), entry.move) == moves.end()) break;
+		pv.push_back(entry.move);
+		undos.push_back(pyke::make_move(pos, entry.move));
+	}
+	for (int i = pv.size() - 1; i >= 0; i--) pyke::unmake_move(pos, pv[i], undos[i]);
+	return pv;
+}
+
+SearchResult Search::run(Position& pos, const SearchLimits& limits,
+						 const std::function<void(const SearchResult&)>& report) {
+	auto start = std::chrono::steady_clock::now();
+	nodes = 0;
+	stopped = false;
+	deadline_ms = limits.movetime_ms > 0 ? now_ms() + limits.movetime_ms : 0;
+	path.clear();
+
+	SearchResult result;
+	MoveBuffer moves;
+	pyke::generate_legal_moves(pos, moves);
+	if (!moves.size()) return result;
+	result.best = moves[0];
+
+	for (int depth = 1; depth <= limits.depth; depth++) {
+		int score = negamax(pos, depth, 0, -score_infinity, score_infinity);
+		if (stopped) break;
+		result.best = root_best;
+		result.score = score;
+		result.depth = depth;
+		result.nodes = nodes;
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		result.pv = principal_variation(pos, depth);
+		if (result.pv.empty() || !(result.pv[0] == root_best)) result.pv = {root_best};
+		if (report) report(result);
+		if (std::abs(score) >= score_mate - depth) break;
+	}
+	result.nodes = nodes;
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
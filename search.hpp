@@ -0,0 +1,72 @@
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "huge_pages.hpp"
+#include "move.hpp"
+#include "position.hpp"
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+// Reference engine on top of generate_legal_moves: iterative deepening alpha-beta with a transposition table,
+// quiescence over captures and promotions, and a material plus piece square table evaluation. It is kept simple on
+// purpose, as a realistic workload for the generator rather than a strong player.
+
+inline constexpr int score_infinity = 32000;
+inline constexpr int score_mate = 31000;
+
+struct SearchLimits {
+	int depth = 64;
+	// Stops the search after this many milliseconds if set.
+	int64_t movetime_ms = 0;
+};
+
+struct SearchResult {
+	Move best;
+	int score = 0;
+	int depth = 0;
+	uint64_t nodes = 0;
+	double seconds = 0;
+	std::vector<Move> pv;
+};
+
+struct TTEntry {
+	uint64_t key = 0;
+	Move move;
+	int16_t score = 0;
+	int8_t depth = -1;
+	uint8_t bound = 0;
+};
+
+// Static evaluation from the side to move, in centipawns.
+int evaluate(Position& pos);
+
+struct Search {
+	explicit Search(size_t tt_mb = 16);
+
+	// Searches until the depth is done or the time is up. report is called after every finished iteration.
+	SearchResult run(Position& pos, const SearchLimits& limits,
+					 const std::function<void(const SearchResult&)>& report = nullptr);
+
+	// Forgets everything learned from earlier searches.
+	void clear();
+
+private:
+	std::vector<TTEntry, HugePageAllocator<TTEntry>> table;
+	// Keys of the positions on the current path, for repetition detection.
+	std::vector<uint64_t> path;
+	Move killers[128][2];
+	Move root_best;
+	uint64_t nodes = 0;
+	int64_t deadline_ms = 0;
+	bool stopped = false;
+
+	int negamax(Position& pos, int depth, int ply, int alpha, int beta);
+	int quiesce(Position& pos, int ply, int alpha, int beta);
+	bool time_up();
+	std::vector<Move> principal_variation(Position& pos, int depth);
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include <immintrin.h>
+
+#include <cstdint>
+
+#ifndef SIMD_H
+#define SIMD_H
+
+// Vectors of bitboards, one per lane. Shifts are the same for every lane, and masks returned by is_zero are all ones
+// or all zeros per lane. U64x1 is the scalar fallback with the same interface.
+
+struct U64x1 {
+	static constexpr int lanes = 1;
+	uint64_t v;
+
+	static inline U64x1 load(const uint64_t* p) { return {*p}; }
+	inline void store(uint64_t* p) const { *p = v; }
+	static inline U64x1 broadcast(uint64_t x) { return {x}; }
+};
+
+inline U64x1 operator&(U64x1 a, U64x1 b) { return {a.v & b.v}; }
+inline U64x1 operator|(U64x1 a, U64x1 b) { return {a.v | b.v}; }
+inline U64x1 operator^(U64x1 a, U64x1 b) { return {a.v ^ b.v}; }
+inline U64x1 operator+(U64x1 a, U64x1 b) { return {a.v + b.v}; }
+inline U64x1 andnot(U64x1 a, U64x1 b) { return {a.v & ~b.v}; }
+inline U64x1 is_zero(U64x1 a) { return {a.v ? 0 : ~0ULL}; }
+inline U64x1 popcount(U64x1 a) { return {uint64_t(__builtin_popcountll(a.v))}; }
+
+// Positive shifts move towards the high bits, negative ones towards the low bits.
+template <int n>
+inline U64x1 shift(U64x1 a) {
+	if constexpr (n > 0)
+		return {a.v << n};
+	else
+		return {a.v >> -n};
+}
+
+#ifdef __AVX2__
+struct U64x4 {
+	static constexpr int lanes = 4;
+	__m256i v;
+
+	static inline U64x4 load(const uint64_t* p) { return {_mm256_load_si256(reinterpret_cast<const __m256i*>(p))}; }
+	inline void store(uint64_t* p) const { _mm256_store_si256(reinterpret_cast<__m256i*>(p), v); }
+	static inline U64x4 broadcast(uint64_t x) { return {_mm256_set1_epi64x(x)}; }
+};
+
+inline U64x4 operator&(U64x4 a, U64x4 b) { return {_mm256_and_si256(a.v, b.v)}; }
+inline U64x4 operator|(U64x4 a, U64x4 b) { return {_mm256_or_si256(a.v, b.v)}; }
+inline U64x4 operator^(U64x4 a, U64x4 b) { return {_mm256_xor_si256(a.v, b.v)}; }
+inline U64x4 operator+(U64x4 a, U64x4 b) { return {_mm256_add_epi64(a.v, b.v)}; }
+inline U64x4 andnot(U64x4 a, U64x4 b) { return {_mm256_andnot_si256(b.v, a.v)}; }
+inline U64x4 is_zero(U64x4 a) { return {_mm256_cmpeq_epi64(a.v, _mm256_setzero_si256())}; }
+
+inline U64x4 popcount(U64x4 a) {
+#if defined(__AVX512VPOPCNTDQ__) && defined(__AVX512VL__)
+	return {_mm256_popcnt_epi64(a.v)};
+#else
+	// Nibble lookup, summed per lane.
+	const __m256i lookup = _mm256_setr_epi8(
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+	);
+	const __m256i low = _mm256_set1_epi8(0x0F);
+	__m256i cnt = _mm256_add_epi8(
+		_mm256_shuffle_epi8(lookup, _mm256_and_si256(a.v, low)),
+		_mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(a.v, 4), low))
+	);
+	return {_mm256_sad_epu8(cnt, _mm256_setzero_si256())};
+#endif
+}
+
+template <int n>
+inline U64x4 shift(U64x4 a) {
+	if constexpr (n > 0)
+		return {_mm256_slli_epi64(a.v, n)};
+	else
+		return {_mm256_srli_epi64(a.v, -n)};
+}
+#endif
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+struct U64x8 {
+	static constexpr int lanes = 8;
+	__m512i v;
+
+	static inline U64x8 load(const uint64_t* p) { return {_mm512_load_si512(p)}; }
+	inline void store(uint64_t* p) const { _mm512_store_si512(p, v); }
+	static inline U64x8 broadcast(uint64_t x) { return {_mm512_set1_epi64(x)}; }
+};
+
+inline U64x8 operator&(U64x8 a, U64x8 b) { return {_mm512_and_si512(a.v, b.v)}; }
+inline U64x8 operator|(U64x8 a, U64x8 b) { return {_mm512_or_si512(a.v, b.v)}; }
+inline U64x8 operator^(U64x8 a, U64x8 b) { return {_mm512_xor_si512(a.v, b.v)}; }
+inline U64x8 operator+(U64x8 a, U64x8 b) { return {_mm512_add_epi64(a.v, b.v)}; }
+inline U64x8 andnot(U64x8 a, U64x8 b) { return {_mm512_andnot_si512(b.v, a.v)}; }
+
+inline U64x8 is_zero(U64x8 a) {
+	return {_mm512_maskz_set1_epi64(_mm512_cmpeq_epi64_mask(a.v, _mm512_setzero_si512()), -1)};
+}
+
+inline U64x8 popcount(U64x8 a) {
+#ifdef __AVX512VPOPCNTDQ__
+	return {_mm512_popcnt_epi64(a.v)};
+#else
+	const __m512i lookup = _mm512_set4_epi32(0x04030302, 0x03020201, 0x03020201, 0x02010100);
+	const __m512i low = _mm512_set1_epi8(0x0F);
+	__m512i cnt = _mm512_add_epi8(
+		_mm512_shuffle_epi8(lookup, _mm512_and_si512(a.v, low)),
+		_mm512_shuffle_epi8(lookup, _mm512_and_si512(_mm512_srli_epi16(a.v, 4), low))
+	);
+	return {_mm512_sad_epu8(cnt, _mm512_setzero_si512())};
+#endif
+}
+
+template <int n>
+inline U64x8 shift(U64x8 a) {
+	if constexpr (n > 0)
+		return {_mm512_slli_epi64(a.v, n)};
+	else
+		return {_mm512_srli_epi64(a.v, -n)};
+}
+#endif
+
+// Widest vector the target supports.
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+using U64xN = U64x8;
+#elif defined(__AVX2__)
+using U64xN = U64x4;
+#else
+using U64xN = U64x1;
+#endif
+
+#endif
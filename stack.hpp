@@ -1,4 +1,5 @@
 
+#include <algorithm>
 #include <cstdio>
 #include <stdexcept>
 
@@ -32,6 +33,13 @@ template <typename T>
 struct Stack {
 	T stack[64];
 	Stack() : last(stack) {};
+	// Copies keep the stack pointer relative to their own storage.
+	Stack(const Stack& other) { *this = other; }
+	Stack& operator=(const Stack& other) {
+		std::copy(other.stack, other.stack + 64, stack);
+		last = stack + (other.last - other.stack);
+		return *this;
+	}
 	void push(T val) { *last++ = val; }
 	T pop() {
 		if (last == stack) return *last;
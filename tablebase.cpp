@@ -0,0 +1,480 @@
+#include "tablebase.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+
+// Signature letters, strongest first.
+static const std::string piece_letters = "QRBNP";
+static constexpr Piece letter_pieces[5] = {QUEEN, ROOK, BISHOP, KNIGHT, PAWN};
+static constexpr int piece_strength[7] = {0, 1, 0, 5, 3, 3, 9};
+
+static int letter_rank(Piece p) {
+	for (int i = 0; i < 5; i++) {
+		if (letter_pieces[i] == p) return i;
+	}
+	return 5;
+}
+
+static void sort_pieces(std::vector<Piece>& pieces) {
+	std::sort(pieces.begin(), pieces.end(), [](Piece a, Piece b) { return letter_rank(a) < letter_rank(b); });
+}
+
+Material Material::parse(const std::string& signature) {
+	Material ret;
+	if (signature.size() < 2 || signature[0] != 'K') throw std::invalid_argument("Bad material " + signature);
+	size_t second = signature.find('K', 1);
+	if (second == std::string::npos) throw std::invalid_argument("Bad material " + signature);
+	for (size_t i = 1; i < signature.size(); i++) {
+		if (i == second) continue;
+		size_t letter = piece_letters.find(signature[i]);
+		if (letter == std::string::npos) throw std::invalid_argument("Bad material " + signature);
+		(i < second ? ret.white : ret.black).push_back(letter_pieces[letter]);
+	}
+	if (ret.white.size() + ret.black.size() + 2 > tb_max_pieces)
+		throw std::invalid_argument("More than " + std::to_string(tb_max_pieces) + " pieces in " + signature);
+	sort_pieces(ret.white);
+	sort_pieces(ret.black);
+	return ret;
+}
+
+Material Material::of(Board& b) {
+	Material ret;
+	for (Piece p : letter_pieces) {
+		for (int i = popcnt(*b.get_board_pointer(true, p)); i > 0; i--) ret.white.push_back(p);
+		for (int i = popcnt(*b.get_board_pointer(false, p)); i > 0; i--) ret.black.push_back(p);
+	}
+	return ret;
+}
+
+std::string Material::signature() const {
+	std::string ret = "K";
+	for (Piece p : white) ret += piece_letters[letter_rank(p)];
+	ret += 'K';
+	for (Piece p : black) ret += piece_letters[letter_rank(p)];
+	return ret;
+}
+
+bool Material::has_pawns() const {
+	return std::count(white.begin(), white.end(), PAWN) || std::count(black.begin(), black.end(), PAWN);
+}
+
+// More total strength first, then more pieces, then the stronger pieces.
+bool Material::is_canonical() const {
+	int ws = 0, bs = 0;
+	for (Piece p : white) ws += piece_strength[p];
+	for (Piece p : black) bs += piece_strength[p];
+	if (ws != bs) return ws > bs;
+	if (white.size() != black.size()) return white.size() > black.size();
+	for (size_t i = 0; i < white.size(); i++) {
+		if (white[i] != black[i]) return letter_rank(white[i]) < letter_rank(black[i]);
+	}
+	return true;
+}
+
+Material Material::flipped() const { return {black, white}; }
+
+/*
+ *	INDEXING
+ */
+
+// The 8 board symmetries as transpose, file flip and rank flip bits. With pawns only 0 and the file flip are used.
+static inline Square transform(Square s, int t) {
+	if (t & 4) s = ((s & 7) << 3) | (s >> 3);
+	if (t & 1) s ^= 7;
+	if (t & 2) s ^= 56;
+	return s;
+}
+
+// Swaps the colors and mirrors the ranks, which keeps the value for the side to move.
+static void flip_colors(Position& in, Position& out) {
+	Board& a = in.board;
+	Board& b = out.board;
+	for (Piece p = PAWN; p <= QUEEN; p++) {
+		*b.get_board_pointer(true, p) = __builtin_bswap64(*a.get_board_pointer(false, p));
+		*b.get_board_pointer(false, p) = __builtin_bswap64(*a.get_board_pointer(true, p));
+	}
+	b.w_board = __builtin_bswap64(a.b_board);
+	b.b_board = __builtin_bswap64(a.w_board);
+	b.occ_board = __builtin_bswap64(a.occ_board);
+	out.wksq = in.bksq ^ 56;
+	out.bksq = in.wksq ^ 56;
+	out.white_turn = !in.white_turn;
+	out.castling_rights = 0;
+	out.ep_flag = 0;
+}
+
+TableLayout::TableLayout(const Material& m) : material(m), king_pair_index(64 * 64, -1) {
+	for (bool white : {true, false}) {
+		for (Piece p : white ? m.white : m.black) {
+			if (!groups.empty() && groups.back().white == white && groups.back().piece == p)
+				groups.back().count++;
+			else
+				groups.push_back({white, p, 1});
+		}
+	}
+
+	// One king pair per symmetry class: the smallest of its images.
+	transforms = m.has_pawns() ? 2 : 8;
+	for (Square wk = 0; wk < 64; wk++) {
+		for (Square bk = 0; bk < 64; bk++) {
+			if (wk == bk || (get_king_move(wk) & square_to_mask(bk))) continue;
+			int pair = wk * 64 + bk;
+			bool smallest = true;
+			for (int t = 1; t < transforms; t++) smallest &= pair <= transform(wk, t) * 64 + transform(bk, t);
+			if (!smallest) continue;
+			king_pair_index[pair] = king_pairs.size();
+			king_pairs.push_back(pair);
+		}
+	}
+
+	per_side = king_pairs.size();
+	for (const Group& g : groups) {
+		for (int i = 0; i < g.count; i++) per_side *= g.piece == PAWN ? 48 : 64;
+	}
+}
+
+uint64_t TableLayout::index(Position& pos) const {
+	Board& b = pos.board;
+	uint64_t best = UINT64_MAX;
+	for (int t = 0; t < transforms; t++) {
+		int pair = king_pair_index[transform(pos.wksq, t) * 64 + transform(pos.bksq, t)];
+		if (pair < 0) continue;
+		uint64_t idx = pair;
+		for (const Group& g : groups) {
+			Square squares[tb_max_pieces];
+			BitBoard bb = *b.get_board_pointer(g.white, g.piece);
+			// Insertion sort, as groups hold at most three pieces.
+			for (int i = 0; i < g.count; i++) {
+				Square s = transform(pop(bb), t);
+				int j = i;
+				for (; j > 0 && squares[j - 1] > s; j--) squares[j] = squares[j - 1];
+				squares[j] = s;
+			}
+			for (int i = 0; i < g.count; i++) idx = g.piece == PAWN ? idx * 48 + squares[i] - 8 : idx * 64 + squares[i];
+		}
+		best = std::min(best, idx);
+	}
+	return (pos.white_turn ? 0 : per_side) + best;
+}
+
+bool TableLayout::decode(uint64_t idx, Position& pos) const {
+	Board& b = pos.board;
+	for (Piece p = PAWN; p <= QUEEN; p++) *b.get_board_pointer(true, p) = *b.get_board_pointer(false, p) = 0;
+	b.w_board = b.b_board = b.occ_board = 0;
+	pos.white_turn = idx < per_side;
+	pos.castling_rights = 0;
+	pos.ep_flag = 0;
+
+	uint64_t rest = idx % per_side;
+	for (int g = groups.size() - 1; g >= 0; g--) {
+		const Group& group = groups[g];
+		for (int i = 0; i < group.count; i++) {
+			Square s = group.piece == PAWN ? rest % 48 + 8 : rest % 64;
+			rest /= group.piece == PAWN ? 48 : 64;
+			if (b.occ_board & square_to_mask(s)) return false;
+			pyke::toggle_piece(b, group.white, group.piece, s);
+		}
+	}
+	pos.wksq = king_pairs[rest] / 64;
+	pos.bksq = king_pairs[rest] % 64;
+	if (b.occ_board & (square_to_mask(pos.wksq) | square_to_mask(pos.bksq))) return false;
+	pyke::toggle_piece(b, true, KING, pos.wksq);
+	pyke::toggle_piece(b, false, KING, pos.bksq);
+
+	// The side that just moved can not be in check.
+	bool illegal = pos.white_turn ? pos.is_attacked<false>(pos.bksq) : pos.is_attacked<true>(pos.wksq);
+	return !illegal && index(pos) == idx;
+}
+
+/*
+ *	FILES
+ */
+
+struct TableHeader {
+	char magic[8];
+	char signature[16];
+	uint64_t size;
+	char reserved[32];
+};
+static_assert(sizeof(TableHeader) == 64);
+
+static const char table_magic[8] = "PYKETB1";
+
+Table::~Table() {
+	if (mapping) munmap(mapping, mapping_size);
+}
+
+void Table::write(const std::string& path) const {
+	TableHeader header{};
+	std::memcpy(header.magic, table_magic, sizeof(header.magic));
+	std::strncpy(header.signature, signature.c_str(), sizeof(header.signature) - 1);
+	header.size = layout.size();
+
+	std::ofstream out(path, std::ios::binary);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(values), layout.size());
+	if (!out) throw std::runtime_error("Can not write table " + path);
+}
+
+std::unique_ptr<Table> Table::map(const std::string& path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) throw std::runtime_error("Can not open table " + path);
+	struct stat st;
+	size_t file_size = fstat(fd, &st) == 0 ? st.st_size : 0;
+	void* mapping = file_size >= sizeof(TableHeader) ? mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+	close(fd);
+	if (mapping == MAP_FAILED) throw std::runtime_error("Can not map table " + path);
+
+	const TableHeader* header = static_cast<const TableHeader*>(mapping);
+	std::unique_ptr<Table> table;
+	if (!std::memcmp(header->magic, table_magic, sizeof(header->magic))) {
+		std::string signature(header->signature, strnlen(header->signature, sizeof(header->signature)));
+		try {
+			table = std::make_unique<Table>(Material::parse(signature));
+		} catch (const std::invalid_argument&) {
+		}
+	}
+	if (!table || header->size != table->layout.size() || file_size != sizeof(TableHeader) + header->size) {
+		munmap(mapping, file_size);
+		throw std::runtime_error("Not a table or truncated: " + path);
+	}
+	table->mapping = mapping;
+	table->mapping_size = file_size;
+	table->values = static_cast<const uint8_t*>(mapping) + sizeof(TableHeader);
+	return table;
+}
+
+/*
+ *	GENERATION
+ */
+
+const Table& Tablebase::load(const std::string& dir, const std::string& signature) {
+	std::string name = Material::parse(signature).signature();
+	std::unique_ptr<Table> table = Table::map(dir + "/" + name + ".pktb");
+	return *(tables[name] = std::move(table));
+}
+
+uint8_t Tablebase::probe(Position& pos) {
+	Material m = Material::of(pos.board);
+	if (m.white.empty() && m.black.empty()) return tb_draw;
+	if (!m.is_canonical()) {
+		thread_local Position flipped;
+		flip_colors(pos, flipped);
+		return probe(flipped);
+	}
+	auto it = tables.find(m.signature());
+	if (it == tables.end()) throw std::invalid_argument("No table for " + m.signature());
+	return it->second->probe(pos);
+}
+
+void Tablebase::write(const std::string& dir) const {
+	for (const auto& [name, table] : tables) table->write(dir + "/" + name + ".pktb");
+}
+
+const Table& Tablebase::build(const std::string& signature) {
+	Material m = Material::parse(signature);
+	if (!m.is_canonical()) m = m.flipped();
+	auto it = tables.find(m.signature());
+	if (it != tables.end()) return *it->second;
+
+	// Captures take a piece off either side, promotions turn a pawn into one of the four pieces.
+	for (bool white : {true, false}) {
+		const std::vector<Piece>& own = white ? m.white : m.black;
+		for (size_t i = 0; i < own.size(); i++) {
+			Material child = m;
+			std::vector<Piece>& pieces = white ? child.white : child.black;
+			pieces.erase(pieces.begin() + i);
+			if (!child.white.empty() || !child.black.empty()) build(child.signature());
+			if (own[i] != PAWN) continue;
+
+			for (Piece promotion : promotion_pieces) {
+				Material promoted = m;
+				std::vector<Piece>& promoted_own = white ? promoted.white : promoted.black;
+				promoted_own[i] = promotion;
+				sort_pieces(promoted_own);
+				build(promoted.signature());
+
+				const std::vector<Piece>& other = white ? promoted.black : promoted.white;
+				for (size_t j = 0; j < other.size(); j++) {
+					Material captured = promoted;
+					std::vector<Piece>& other_pieces = white ? captured.black : captured.white;
+					other_pieces.erase(other_pieces.begin() + j);
+					build(captured.signature());
+				}
+			}
+		}
+	}
+
+	auto table = std::make_unique<Table>(m);
+	generate(*table);
+	return *(tables[m.signature()] = std::move(table));
+}
+
+// Retrograde analysis. The first pass makes every move forward: mates and stalemates are final, moves that leave
+// the table are probed in the smaller tables, and the distinct in-table successors are counted. The next passes go
+// through the positions decided at ply d and take back moves from them: predecessors of a loss are wins at d + 1, and a
+// predecessor of a win whose last successor just got decided is a loss. Wins found by probing are kept as upper bounds
+// until a pass finds a shorter one.
+void Tablebase::generate(Table& table) {
+	auto start = std::chrono::steady_clock::now();
+	const TableLayout& layout = table.layout;
+	uint64_t size = layout.size();
+	table.storage.assign(size, tb_draw);
+	table.values = table.storage.data();
+	uint8_t* values = table.storage.data();
+	// Successors left to decide, with the high bit set when a move draws.
+	std::vector<uint8_t, HugePageAllocator<uint8_t>> pending(size);
+	// Longest loss through a move out of the table.
+	std::vector<uint8_t, HugePageAllocator<uint8_t>> worst_loss(size);
+
+	constexpr uint8_t draw_bit = 0x80;
+	constexpr uint64_t chunk = 1 << 14;
+	uint64_t chunks = (size + chunk - 1) / chunk;
+	std::vector<Position> positions(pool.size());
+	std::atomic<int> longest = 0;
+	std::exception_ptr error;
+	std::mutex error_mutex;
+
+	auto decide = [&](uint8_t* value, int plies) {
+		if (plies >= tb_invalid - 1) throw std::runtime_error("Mate too long for table " + table.signature);
+		*value = plies + 1;
+		int seen = longest;
+		while (seen < plies && !longest.compare_exchange_weak(seen, plies)) {
+		}
+	};
+
+	auto run = [&](auto&& body) {
+		pool.parallel_for(chunks, [&](size_t c, unsigned thread) {
+			try {
+				for (uint64_t i = c * chunk; i < std::min(size, (c + 1) * chunk); i++) body(i, positions[thread]);
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(error_mutex);
+				if (!error) error = std::current_exception();
+			}
+		});
+		if (error) std::rethrow_exception(error);
+	};
+
+	run([&](uint64_t i, Position& pos) {
+		if (!layout.decode(i, pos)) {
+			values[i] = tb_invalid;
+			return;
+		}
+		MoveBuffer moves;
+		pyke::generate_legal_moves(pos, moves);
+		bool in_check = pos.white_turn ? pos.is_attacked<true>(pos.wksq) : pos.is_attacked<false>(pos.bksq);
+		if (!moves.size()) {
+			if (in_check)
+				decide(&values[i], 0);
+			else
+				pending[i] = draw_bit;
+			return;
+		}
+
+		uint64_t successors[256];
+		int count = 0;
+		int best_win = 0;
+		int loss = 0;
+		bool draw = false;
+		for (Move m : moves) {
+			MoveUndo undo = pyke::make_move(pos, m);
+			if (m.get_captured() != EMPTY || m.get_promotion() != EMPTY) {
+				uint8_t v = probe(pos);
+				if (v == tb_draw)
+					draw = true;
+				else if ((v - 1) % 2 == 0)
+					best_win = best_win ? std::min(best_win, int(v)) : v;
+				else
+					loss = std::max(loss, int(v));
+			} else {
+				successors[count++] = layout.index(pos);
+			}
+			pyke::unmake_move(pos, m, undo);
+		}
+		std::sort(successors, successors + count);
+		count = std::unique(successors, successors + count) - successors;
+
+		pending[i] = count | (draw ? draw_bit : 0);
+		worst_loss[i] = loss;
+		if (best_win)
+			decide(&values[i], best_win);
+		else if (!count && !draw)
+			decide(&values[i], loss);
+	});
+
+	int passes = 1;
+	for (int d = 0; d <= longest; d++, passes++) {
+		uint8_t decided = d + 1;
+		run([&](uint64_t i, Position& pos) {
+			if (values[i] != decided) return;
+			layout.decode(i, pos);
+			MoveBuffer unmoves;
+			if (pos.white_turn)
+				pyke::generate_unmoves<false>(pos, unmoves);
+			else
+				pyke::generate_unmoves<true>(pos, unmoves);
+
+			uint64_t predecessors[256];
+			int count = 0;
+			for (Move m : unmoves) {
+				MoveUndo undo{0, 0};
+				pyke::unmake_move(pos, m, undo);
+				// The side that is not to move in the predecessor may not be in check.
+				bool legal = pos.white_turn ? !pos.is_attacked<false>(pos.bksq) : !pos.is_attacked<true>(pos.wksq);
+				if (legal) predecessors[count++] = layout.index(pos);
+				pyke::make_move(pos, m);
+				pos.ep_flag = 0;
+			}
+			std::sort(predecessors, predecessors + count);
+			count = std::unique(predecessors, predecessors + count) - predecessors;
+
+			for (int p = 0; p < count; p++) {
+				std::atomic_ref<uint8_t> value(values[predecessors[p]]);
+				uint8_t v = value;
+				if (d % 2 == 0) {
+					// A move into a loss wins, and replaces a longer win found by probing.
+					while ((v == tb_draw || ((v - 1) % 2 && v > decided + 1)) && !value.compare_exchange_weak(v, decided + 1)) {
+					}
+					int seen = longest;
+					while (seen < d + 1 && !longest.compare_exchange_weak(seen, d + 1)) {
+					}
+				} else if (v == tb_draw) {
+					std::atomic_ref<uint8_t> left(pending[predecessors[p]]);
+					uint8_t before = left.fetch_sub(1);
+					if ((before & ~draw_bit) != 1 || (before & draw_bit)) continue;
+					int plies = std::max(d + 1, int(worst_loss[predecessors[p]]));
+					if (plies >= tb_invalid - 1) throw std::runtime_error("Mate too long for table " + table.signature);
+					uint8_t expected = tb_draw;
+					value.compare_exchange_strong(expected, plies + 1);
+					int seen = longest;
+					while (seen < plies && !longest.compare_exchange_weak(seen, plies)) {
+					}
+				}
+			}
+		});
+	}
+
+	TableStats s{table.signature};
+	for (uint64_t i = 0; i < size; i++) {
+		int wdl = tb_wdl(values[i]);
+		s.invalid += values[i] == tb_invalid;
+		s.draws += values[i] == tb_draw;
+		s.wins += wdl > 0;
+		s.losses += wdl < 0;
+		s.longest = std::max(s.longest, tb_dtm(values[i]));
+	}
+	s.passes = passes;
+	s.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	stats.push_back(s);
+}
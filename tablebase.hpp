@@ -0,0 +1,183 @@
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "huge_pages.hpp"
+#include "movegen.hpp"
+#include "position.hpp"
+#include "thread_pool.hpp"
+
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+// Retrograde endgame tables for up to 5 pieces, kings included. Every table holds one byte per index: 0 is a draw,
+// otherwise value - 1 is the distance to mate in plies, odd for a win of the side to move and even for a loss.
+// tb_invalid marks indices without a legal position. Castling and ep rights are not part of the tables.
+
+inline constexpr uint8_t tb_draw = 0;
+inline constexpr uint8_t tb_invalid = 255;
+inline constexpr int tb_max_pieces = 5;
+
+// Win (1), draw (0) or loss (-1) for the side to move.
+inline int tb_wdl(uint8_t value) {
+	return value == tb_draw || value == tb_invalid ? 0 : (value - 1) % 2 ? 1 : -1;
+}
+
+// Plies to mate, or -1 for draws.
+inline int tb_dtm(uint8_t value) { return value == tb_draw || value == tb_invalid ? -1 : value - 1; }
+
+// Pieces besides the kings, strongest first. Written as signatures such as "KQK" or "KRPKR", white first.
+struct Material {
+	std::vector<Piece> white;
+	std::vector<Piece> black;
+
+	// Throws std::invalid_argument on malformed signatures and on more than tb_max_pieces pieces.
+	static Material parse(const std::string& signature);
+	static Material of(Board& b);
+
+	std::string signature() const;
+	bool has_pawns() const;
+	// Tables are stored with the stronger side as white; the other color order is probed color flipped.
+	bool is_canonical() const;
+	Material flipped() const;
+};
+
+// Perfect index over the positions of a material. The king pair is reduced by the board symmetries, 8 without pawns
+// and the left-right mirror with pawns, to one index per symmetry class. Every other piece adds a digit of its
+// square, 48 for pawns. Indices that decode to an overlap, an illegal position or a non canonical one are invalid.
+struct TableLayout {
+	explicit TableLayout(const Material& material);
+
+	uint64_t size() const { return 2 * per_side; }
+
+	// Index of a position with this material.
+	uint64_t index(Position& pos) const;
+	// Sets up pos from an index. Returns false if no legal canonical position has this index.
+	bool decode(uint64_t idx, Position& pos) const;
+
+private:
+	struct Group {
+		bool white;
+		Piece piece;
+		int count;
+	};
+
+	Material material;
+	std::vector<Group> groups;
+	int transforms;
+	std::vector<int16_t> king_pair_index;
+	std::vector<uint16_t> king_pairs;
+	uint64_t per_side;
+};
+
+// A built or mapped table.
+struct Table {
+	std::string signature;
+	TableLayout layout;
+	const uint8_t* values = nullptr;
+
+	explicit Table(const Material& material) : signature(material.signature()), layout(material) {}
+	~Table();
+	Table(const Table&) = delete;
+	Table& operator=(const Table&) = delete;
+
+	uint8_t probe(Position& pos) const { return values[layout.index(pos)]; }
+
+	// Raw values behind a 64 byte header, so the file can be mapped and probed in place.
+	void write(const std::string& path) const;
+	// Maps a file written by write(). Throws std::runtime_error if it can not be read or does not match.
+	static std::unique_ptr<Table> map(const std::string& path);
+
+private:
+	friend struct Tablebase;
+	std::vector<uint8_t, HugePageAllocator<uint8_t>> storage;
+	void* mapping = nullptr;
+	size_t mapping_size = 0;
+};
+
+struct TableStats {
+	std::string signature;
+	uint64_t wins = 0;
+	uint64_t losses = 0;
+	uint64_t draws = 0;
+	uint64_t invalid = 0;
+	int longest = 0;
+	int passes = 0;
+	double seconds = 0;
+};
+
+// Set of tables, built in memory or mapped from files. Building a table first builds every table its captures and
+// promotions lead to.
+struct Tablebase {
+	explicit Tablebase(unsigned threads = 1, PinPolicy pin = PinPolicy::NONE) : pool(threads, pin) {}
+
+	const Table& build(const std::string& signature);
+	// Maps <dir>/<signature>.pktb.
+	const Table& load(const std::string& dir, const std::string& signature);
+	// Value of the position with the side to move. Throws std::invalid_argument if its table is missing.
+	uint8_t probe(Position& pos);
+	// Writes every table to <dir>/<signature>.pktb.
+	void write(const std::string& dir) const;
+
+	std::vector<TableStats> stats;
+	const Placement& placement() const { return pool.get_placement(); }
+
+private:
+	ThreadPool pool;
+	std::map<std::string, std::unique_ptr<Table>> tables;
+
+	void generate(Table& table);
+};
+
+namespace pyke {
+
+// Quiet moves of the given side that lead into pos, which has the other side to move. Taking one back with unmake_move
+// gives a predecessor; un-captures and un-promotions change the material and are not generated.
+template <bool white>
+static inline void generate_unmoves(Position& pos, MoveBuffer& out) {
+	out.clear();
+	Board& b = pos.board;
+	BitBoard empty = ~b.occ_board;
+	BitBoard pieces = b.get_player_occ<white>();
+	while (pieces) {
+		Square sq = pop(pieces);
+		Piece p = b.get_piece<white>(sq);
+		BitBoard prev;
+		switch (p) {
+		case KING:
+			prev = get_king_move(sq);
+			break;
+		case KNIGHT:
+			prev = get_knight_move(sq);
+			break;
+		case BISHOP:
+			prev = get_bishop_move(sq, b.occ_board);
+			break;
+		case ROOK:
+			prev = get_rook_move(sq, b.occ_board);
+			break;
+		case QUEEN:
+			prev = get_queen_move(sq, b.occ_board);
+			break;
+		default: {
+			// White pawns move towards lower square numbers.
+			int step = white ? 8 : -8;
+			BitBoard back = square_to_mask(sq + step) & empty & ~promotion_to_squares;
+			if (!back) continue;
+			out.push(Move(MOVE_NORMAL, PAWN, sq + step, sq));
+			if (square_to_mask(sq + 2 * step) & (white ? pawn_start_w : pawn_start_b) & empty)
+				out.push(Move(MOVE_DOUBLE, PAWN, sq + 2 * step, sq));
+			continue;
+		}
+		}
+		prev &= empty;
+		while (prev) out.push(Move(MOVE_NORMAL, p, pop(prev), sq));
+	}
+}
+
+};	// namespace pyke
+
+#endif
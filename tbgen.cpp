@@ -0,0 +1,75 @@
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tablebase.hpp"
+
+// Builds endgame tables and the tables they depend on, or maps written ones, and probes positions in them.
+
+static void print_value(const std::string& fen, uint8_t value) {
+	if (value == tb_invalid) {
+		std::cout << fen << ": illegal\n";
+		return;
+	}
+	int wdl = tb_wdl(value);
+	std::cout << fen << ": " << (wdl > 0 ? "win" : wdl < 0 ? "loss" : "draw");
+	if (wdl) std::cout << ", mate in " << tb_dtm(value) << " plies";
+	std::cout << '\n';
+}
+
+int main(int argc, char* argv[]) {
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	PinPolicy pin = PinPolicy::NONE;
+	std::string out_dir, in_dir;
+	std::vector<std::string> signatures, probes;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc) {
+			threads = std::stoi(argv[++i]);
+		} else if (arg == "--pin" && i + 1 < argc) {
+			pin = parse_pin_policy(argv[++i]);
+		} else if (arg == "--out" && i + 1 < argc) {
+			out_dir = argv[++i];
+		} else if (arg == "--dir" && i + 1 < argc) {
+			in_dir = argv[++i];
+		} else if (arg == "--probe" && i + 1 < argc) {
+			probes.push_back(argv[++i]);
+		} else if (!arg.empty() && arg[0] != '-') {
+			signatures.push_back(arg);
+		} else {
+			std::cout << "Usage: tbgen [--threads N] [--pin POLICY] [--out DIR] [--dir DIR] [--probe FEN]... "
+						 "SIGNATURE...\n"
+					  << "Builds the tables of the signatures (KQK, KRK, KBNK, KPK, ...), or maps them from --dir.\n";
+			return 1;
+		}
+	}
+
+	Tablebase tb(threads, pin);
+	try {
+		for (const std::string& sig : signatures) {
+			if (in_dir.empty())
+				tb.build(sig);
+			else
+				tb.load(in_dir, sig);
+		}
+		for (const TableStats& s : tb.stats) {
+			std::cout << s.signature << ": " << s.wins << " wins, " << s.losses << " losses, " << s.draws << " draws, "
+					  << s.invalid << " invalid, longest mate " << s.longest << " plies, " << s.passes << " passes, "
+					  << s.seconds << " s\n";
+		}
+		if (!tb.stats.empty()) std::cout << "threads: " << tb.placement().describe() << '\n';
+		if (!out_dir.empty()) tb.write(out_dir);
+		for (const std::string& fen : probes) {
+			Position pos;
+			pos.load_fen(fen);
+			print_value(fen, tb.probe(pos));
+		}
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+	return 0;
+}
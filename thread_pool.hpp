@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "perf_counter.hpp"
+#include "topology.hpp"
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+// Fixed set of worker threads that run index ranges. The calling thread takes part in the work, so a pool of size 1
+// has no workers and runs everything inline. With a pin policy every thread, the caller included, runs on its own cpu
+// and reads the slider tables from a replica on its NUMA node; the caller gets its affinity back when the pool goes.
+struct ThreadPool {
+	// Called with the item index and the id of the thread running it, in [0, size()).
+	using Task = std::function<void(size_t, unsigned)>;
+
+	explicit ThreadPool(unsigned threads, PinPolicy policy = PinPolicy::NONE)
+		: placement(plan_placement(Topology::discover(), policy, threads)) {
+		if (placement.pinned()) {
+			replicas = std::make_unique<TableReplicas>(placement.nodes);
+			CPU_ZERO(&caller_affinity);
+			sched_getaffinity(0, sizeof(caller_affinity), &caller_affinity);
+			caller_tables = thread_lookup_tables;
+			enter(0);
+		}
+		for (unsigned id = 1; id < std::max(1u, threads); id++) workers.emplace_back([this, id] {
+			enter(id);
+			work(id);
+		});
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			generation++;
+		}
+		wake.notify_all();
+		for (std::thread& t : workers) t.join();
+		if (placement.pinned()) {
+			sched_setaffinity(0, sizeof(caller_affinity), &caller_affinity);
+			thread_lookup_tables = caller_tables;
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	unsigned size() const { return workers.size() + 1; }
+	const Placement& get_placement() const { return placement; }
+
+	// Counts hardware events per thread while the threads run tasks, until detached with nullptr. The counters must
+	// hold a set per thread.
+	void attach_counters(ThreadCounters* thread_counters) { counters = thread_counters; }
+
+	// Runs task(i, thread) for all i in [0, n) and returns when every item is done. Not reentrant.
+	void parallel_for(size_t n, const Task& task) {
+		if (workers.empty()) {
+			if (counters) counters->resume(0);
+			for (size_t i = 0; i < n; i++) task(i, 0);
+			if (counters) counters->pause(0);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			current = &task;
+			count = n;
+			next = 0;
+			active = workers.size();
+			generation++;
+		}
+		wake.notify_all();
+		run(0);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this] { return active == 0; });
+		current = nullptr;
+	}
+
+private:
+	Placement placement;
+	std::unique_ptr<TableReplicas> replicas;
+	cpu_set_t caller_affinity;
+	const LookupTables* caller_tables = nullptr;
+	ThreadCounters* counters = nullptr;
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const Task* current = nullptr;
+	size_t count = 0;
+	std::atomic<size_t> next = 0;
+	size_t active = 0;
+	uint64_t generation = 0;
+	bool stopping = false;
+
+	void enter(unsigned id) {
+		if (!placement.pinned()) return;
+		const CpuInfo& cpu = placement.threads[id];
+		pin_current_thread(cpu.cpu);
+		thread_lookup_tables = replicas->on_node(cpu.node);
+	}
+
+	void run(unsigned id) {
+		if (counters) counters->resume(id);
+		for (size_t i = next++; i < count; i = next++) (*current)(i, id);
+		if (counters) counters->pause(id);
+	}
+
+	void work(unsigned id) {
+		uint64_t seen = 0;
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&] { return generation != seen; });
+				seen = generation;
+				if (stopping) return;
+			}
+			run(id);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				active--;
+			}
+			done.notify_one();
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,234 @@
+#include <sched.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "huge_pages.hpp"
+#include "lookup_tables.hpp"
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+// CPU topology from sysfs and thread placement over it. Machines without the sysfs entries show up as one node with
+// one core per cpu.
+
+struct CpuInfo {
+	int cpu;
+	int package;
+	int core;
+	int node;
+};
+
+// Parses cpu and node lists such as "0-3,8-11".
+inline std::vector<int> parse_cpu_list(const std::string& list) {
+	std::vector<int> cpus;
+	std::stringstream ss(list);
+	std::string range;
+	while (std::getline(ss, range, ',')) {
+		if (range.empty() || range == "\n") continue;
+		size_t dash = range.find('-');
+		int first = std::stoi(range.substr(0, dash));
+		int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+		for (int c = first; c <= last; c++) cpus.push_back(c);
+	}
+	return cpus;
+}
+
+struct Topology {
+	// Cpus this process may run on.
+	std::vector<CpuInfo> cpus;
+	int nodes = 1;
+	int cores = 0;
+
+	static Topology discover(const std::string& sysfs = "/sys/devices/system") {
+		auto read_line = [](const std::string& path, std::string& line) {
+			std::ifstream in(path);
+			return bool(std::getline(in, line));
+		};
+		auto read_int = [&](const std::string& path, int fallback) {
+			std::string line;
+			return read_line(path, line) && !line.empty() ? std::stoi(line) : fallback;
+		};
+
+		cpu_set_t allowed;
+		CPU_ZERO(&allowed);
+		bool have_mask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+		std::string online;
+		std::vector<int> ids;
+		if (read_line(sysfs + "/cpu/online", online)) ids = parse_cpu_list(online);
+		if (ids.empty())
+			for (unsigned c = 0; c < std::max(1u, std::thread::hardware_concurrency()); c++) ids.push_back(c);
+
+		std::map<int, int> node_of;
+		std::string node_list;
+		if (read_line(sysfs + "/node/online", node_list)) {
+			for (int node : parse_cpu_list(node_list)) {
+				std::string list;
+				if (!read_line(sysfs + "/node/node" + std::to_string(node) + "/cpulist", list)) continue;
+				for (int c : parse_cpu_list(list)) node_of[c] = node;
+			}
+		}
+
+		Topology t;
+		std::map<int, int> node_index;
+		std::map<std::tuple<int, int>, int> core_index;
+		for (int c : ids) {
+			if (have_mask && (c >= CPU_SETSIZE || !CPU_ISSET(c, &allowed))) continue;
+			std::string dir = sysfs + "/cpu/cpu" + std::to_string(c) + "/topology/";
+			int package = read_int(dir + "physical_package_id", 0);
+			int core = read_int(dir + "core_id", c);
+			auto found = node_of.find(c);
+			int node = found == node_of.end() ? 0 : found->second;
+			// Dense numbering, as node and core ids of the allowed cpus need not be contiguous.
+			node = node_index.emplace(node, node_index.size()).first->second;
+			core = core_index.emplace(std::make_tuple(package, core), core_index.size()).first->second;
+			t.cpus.push_back({c, package, core, node});
+		}
+		if (t.cpus.empty()) t.cpus.push_back({0, 0, 0, 0});
+		t.nodes = std::max<int>(1, node_index.size());
+		t.cores = std::max<int>(1, core_index.size());
+		return t;
+	}
+};
+
+// How a pool puts its threads on cpus:
+//   none     leave it to the scheduler.
+//   compact  fill a node, SMT siblings next to each other, before the next node.
+//   scatter  alternate over the nodes, one thread per core before the SMT siblings.
+//   cores    one thread per core over all nodes before the SMT siblings.
+enum class PinPolicy : uint8_t { NONE, COMPACT, SCATTER, CORES };
+
+inline const char* pin_policy_name(PinPolicy policy) {
+	switch (policy) {
+	case PinPolicy::COMPACT:
+		return "compact";
+	case PinPolicy::SCATTER:
+		return "scatter";
+	case PinPolicy::CORES:
+		return "cores";
+	default:
+		return "none";
+	}
+}
+
+// Throws std::invalid_argument on unknown names.
+inline PinPolicy parse_pin_policy(const std::string& name) {
+	for (PinPolicy p : {PinPolicy::NONE, PinPolicy::COMPACT, PinPolicy::SCATTER, PinPolicy::CORES})
+		if (name == pin_policy_name(p)) return p;
+	throw std::invalid_argument("Unknown pin policy '" + name + "', expected none, compact, scatter or cores");
+}
+
+// Cpu and node of every pool thread, by thread id.
+struct Placement {
+	PinPolicy policy = PinPolicy::NONE;
+	std::vector<CpuInfo> threads;
+	int nodes = 1;
+	int cores = 1;
+
+	bool pinned() const { return policy != PinPolicy::NONE; }
+
+	// For timing output, e.g. "4 threads, compact on 1 node, 2 cores: cpus 0,1,2,3".
+	std::string describe() const {
+		std::ostringstream out;
+		out << threads.size() << (threads.size() == 1 ? " thread, " : " threads, ") << pin_policy_name(policy);
+		if (!pinned()) return out.str();
+		int used_nodes = 0, used_cores = 0;
+		std::vector<bool> node_seen(nodes), core_seen(cores);
+		for (const CpuInfo& c : threads) {
+			used_nodes += !node_seen[c.node];
+			used_cores += !core_seen[c.core];
+			node_seen[c.node] = core_seen[c.core] = true;
+		}
+		out << " on " << used_nodes << (used_nodes == 1 ? " node, " : " nodes, ") << used_cores
+			<< (used_cores == 1 ? " core: cpus " : " cores: cpus ");
+		for (size_t i = 0; i < threads.size(); i++) out << (i ? "," : "") << threads[i].cpu;
+		return out.str();
+	}
+};
+
+inline Placement plan_placement(const Topology& topology, PinPolicy policy, unsigned threads) {
+	Placement placement;
+	placement.policy = policy;
+	placement.nodes = topology.nodes;
+	placement.cores = topology.cores;
+
+	std::vector<CpuInfo> order = topology.cpus;
+	std::stable_sort(order.begin(), order.end(), [](const CpuInfo& a, const CpuInfo& b) {
+		return std::tie(a.node, a.core, a.cpu) < std::tie(b.node, b.core, b.cpu);
+	});
+	// Rank of each cpu among the SMT siblings of its core, and of its core within the node.
+	std::vector<int> sibling(order.size());
+	std::vector<int> node_slot(order.size());
+	std::map<int, int> siblings_seen, cores_in_node;
+	for (size_t i = 0; i < order.size(); i++) {
+		sibling[i] = siblings_seen[order[i].core]++;
+		if (!sibling[i]) node_slot[i] = cores_in_node[order[i].node]++;
+	}
+	for (size_t i = 0; i < order.size(); i++)
+		if (sibling[i]) node_slot[i] = node_slot[i - sibling[i]];
+
+	std::vector<size_t> rank(order.size());
+	for (size_t i = 0; i < order.size(); i++) rank[i] = i;
+	auto key = [&](size_t i) {
+		switch (policy) {
+		case PinPolicy::SCATTER:
+			return std::make_tuple(sibling[i], node_slot[i], order[i].node);
+		case PinPolicy::CORES:
+			return std::make_tuple(sibling[i], order[i].node, node_slot[i]);
+		default:
+			return std::make_tuple(order[i].node, node_slot[i], sibling[i]);
+		}
+	};
+	std::stable_sort(rank.begin(), rank.end(), [&](size_t a, size_t b) { return key(a) < key(b); });
+
+	for (unsigned t = 0; t < std::max(1u, threads); t++) placement.threads.push_back(order[rank[t % rank.size()]]);
+	return placement;
+}
+
+inline bool pin_current_thread(int cpu) {
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+// Copies of the read only slider tables, one per NUMA node. A replica is made by the first thread pinned to its node
+// and is first touched there, so the kernel places its pages on that node.
+struct TableReplicas {
+	explicit TableReplicas(int nodes) : nodes(nodes), slots(new Slot[nodes]) {}
+	~TableReplicas() {
+		for (int n = 0; n < nodes; n++) huge_free(slots[n].tables, sizeof(LookupTables));
+	}
+	TableReplicas(const TableReplicas&) = delete;
+	TableReplicas& operator=(const TableReplicas&) = delete;
+
+	const LookupTables* on_node(int node) {
+		Slot& slot = slots[node];
+		std::call_once(slot.once, [&] {
+			slot.tables = static_cast<LookupTables*>(huge_alloc(sizeof(LookupTables)));
+			std::memcpy(static_cast<void*>(slot.tables), &lookup_tables, sizeof(LookupTables));
+		});
+		return slot.tables;
+	}
+
+private:
+	struct Slot {
+		std::once_flag once;
+		LookupTables* tables = nullptr;
+	};
+	int nodes;
+	std::unique_ptr<Slot[]> slots;
+};
+
+#endif
@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "movegen.hpp"
+#include "perft.hpp"
+#include "perft_cache.hpp"
+#include "search.hpp"
+
+// Long lived engine process speaking the UCI subset needed by perft tooling and the reference search: uci, isready,
+// ucinewgame, position [startpos | fen <fen>] [moves <moves>], go perft <depth>, go [depth <n>] [movetime <ms>],
+// bench [depth], d, setoption name PerftCache value <file> and quit. Lookup tables are built once at startup, so
+// shallow queries are answered without any setup cost. With a PerftCache file, go perft looks subtrees up in it and
+// stores the ones it counts, so it is kept across processes.
+//
+// When started with arguments it runs a single query instead: pyke_uci <depth> <fen> [<moves>] for perftree, or
+// pyke_uci bench [depth].
+
+const std::string start_fen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+// Fixed positions for the search benchmark, from opening to endgame.
+const std::vector<std::string> bench_fens = {
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+	"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+	"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+	"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+	"r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+	"r2q1rk1/pp2bppp/2n1pn2/3p4/3P4/2NBPN2/PP3PPP/R2Q1RK1 b - - 3 10",
+	"2r3k1/5pp1/p3p2p/1p1pP3/3P4/P1R2N1P/1P3PP1/6K1 b - - 0 28",
+	"8/5k2/3p4/1p1Pp2p/pP2Pp1P/P4P1K/8/8 b - - 99 50",
+};
+
+constexpr int bench_depth = 6;
+
+// Handles "position ..." arguments. Leaves the position untouched if the command is malformed.
+static void set_position(Position& pos, std::istringstream& args) {
+	std::string token, fen;
+	args >> token;
+	if (token == "startpos") {
+		fen = start_fen;
+		args >> token;
+	} else if (token == "fen") {
+		while (args >> token && token != "moves") fen += token + ' ';
+	} else {
+		return;
+	}
+
+	Position next;
+	try {
+		next.load_fen(fen);
+		if (token == "moves") {
+			while (args >> token) next.play_move(token);
+		}
+	} catch (const std::invalid_argument& e) {
+		std::cout << "info string " << e.what() << std::endl;
+		return;
+	}
+	pos = next;
+}
+
+// Divide in the Stockfish format understood by most perft tooling. With PYKE_COUNTERS=1 the hardware counter rates
+// follow as info strings.
+static void go_perft(Position& pos, int depth, PerftCache* cache) {
+	std::unique_ptr<CounterSet> counters = counters_requested() ? std::make_unique<CounterSet>() : nullptr;
+	if (counters) counters->start();
+	auto start = std::chrono::steady_clock::now();
+	NodeCount nodes = 0;
+	if (cache) {
+		MoveBuffer moves;
+		pyke::generate_legal_moves(pos, moves);
+		for (Move m : moves) {
+			MoveUndo undo = pyke::make_move(pos, m);
+			NodeCount move_nodes = cache->count(pos, depth - 1);
+			pyke::unmake_move(pos, m, undo);
+			std::cout << m.to_string() << ": " << move_nodes << '\n';
+			nodes += move_nodes;
+		}
+	} else {
+		nodes = count_root(pos, depth, true);
+	}
+	auto end = std::chrono::steady_clock::now();
+	CounterValues counted = counters ? counters->stop() : CounterValues();
+	auto us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+	std::cout << "\nNodes searched: " << nodes << '\n';
+	std::cout << "info nodes " << nodes << " time " << us / 1000 << " nps " << (us ? nodes * 1000000 / us : 0)
+			  << std::endl;
+	if (counters) print_counters(std::cout, counted, nodes, us / 1e6, "info string ");
+	if (cache) {
+		const PerftCacheStats& s = cache->stats();
+		std::cout << "info string perft cache " << s.hits << " hits " << s.misses << " misses " << s.stored
+				  << " stored " << s.dropped << " dropped" << std::endl;
+	}
+}
+
+// Handles "setoption name <name> value <value>".
+static void set_option(std::unique_ptr<PerftCache>& cache, std::istringstream& args) {
+	std::string token, name, value;
+	args >> token;
+	while (args >> token && token != "value") name += (name.empty() ? "" : " ") + token;
+	std::getline(args >> std::ws, value);
+	if (name != "PerftCache") {
+		std::cout << "info string unknown option " << name << std::endl;
+		return;
+	}
+	cache.reset();
+	if (value.empty() || value == "<empty>") return;
+	try {
+		cache = std::make_unique<PerftCache>(value);
+	} catch (const std::runtime_error& e) {
+		std::cout << "info string " << e.what() << std::endl;
+	}
+}
+
+static void print_info(const SearchResult& r) {
+	std::cout << "info depth " << r.depth << " score ";
+	if (std::abs(r.score) >= score_mate - 1000) {
+		int plies = score_mate - std::abs(r.score);
+		std::cout << "mate " << (r.score > 0 ? (plies + 1) / 2 : -(plies / 2));
+	} else {
+		std::cout << "cp " << r.score;
+	}
+	auto ms = uint64_t(r.seconds * 1000);
+	std::cout << " nodes " << r.nodes << " time " << ms << " nps " << uint64_t(r.nodes / std::max(r.seconds, 1e-6))
+			  << " pv";
+	for (const Move& m : r.pv) std::cout << ' ' << m.to_string();
+	std::cout << std::endl;
+}
+
+static void go_search(Search& search, Position& pos, const SearchLimits& limits) {
+	SearchResult r = search.run(pos, limits, print_info);
+	std::cout << "bestmove " << (r.best.is_null() ? "0000" : r.best.to_string()) << std::endl;
+}
+
+// Searches every bench position to a fixed depth from an empty table and reports the total nodes and speed, and with
+// PYKE_COUNTERS=1 the hardware counter rates of the searches.
+static int bench(int depth) {
+	Search search;
+	uint64_t nodes = 0;
+	double seconds = 0;
+	std::unique_ptr<CounterSet> counters = counters_requested() ? std::make_unique<CounterSet>() : nullptr;
+	for (const std::string& fen : bench_fens) {
+		Position pos;
+		pos.load_fen(fen);
+		search.clear();
+		SearchLimits limits;
+		limits.depth = depth;
+		if (counters) counters->resume();
+		SearchResult r = search.run(pos, limits);
+		if (counters) counters->pause();
+		std::cout << "Position " << fen << ": bestmove " << r.best.to_string() << ", nodes " << r.nodes << '\n';
+		nodes += r.nodes;
+		seconds += r.seconds;
+	}
+	std::cout << "\nNodes searched: " << nodes << "\nNodes/second: " << uint64_t(nodes / std::max(seconds, 1e-6))
+			  << std::endl;
+	if (counters) print_counters(std::cout, counters->read(), nodes, seconds);
+	return 0;
+}
+
+static int uci_loop() {
+	Search search;
+	Position pos;
+	pos.load_fen(start_fen);
+	std::unique_ptr<PerftCache> cache;
+	std::string line;
+
+	while (std::getline(std::cin, line)) {
+		std::istringstream args(line);
+		std::string cmd;
+		args >> cmd;
+
+		if (cmd == "uci") {
+			std::cout << "id name Pyke\nid author Nathanael Mohanu\n"
+					  << "option name PerftCache type string default <empty>\nuciok" << std::endl;
+		} else if (cmd == "setoption") {
+			set_option(cache, args);
+		} else if (cmd == "isready") {
+			std::cout << "readyok" << std::endl;
+		} else if (cmd == "ucinewgame") {
+			pos = Position();
+			pos.load_fen(start_fen);
+			search.clear();
+		} else if (cmd == "position") {
+			set_position(pos, args);
+		} else if (cmd == "go") {
+			// Without a limit the search stops at the bench depth, as there is no stop command.
+			std::string token;
+			SearchLimits limits;
+			limits.depth = 0;
+			int perft_depth = 0;
+			while (args >> token) {
+				if (token == "perft")
+					args >> perft_depth;
+				else if (token == "depth")
+					args >> limits.depth;
+				else if (token == "movetime")
+					args >> limits.movetime_ms;
+			}
+			if (perft_depth > 0) {
+				go_perft(pos, perft_depth, cache.get());
+			} else {
+				if (limits.depth <= 0) limits.depth = limits.movetime_ms > 0 ? 64 : bench_depth;
+				limits.depth = std::min(limits.depth, 64);
+				go_search(search, pos, limits);
+			}
+		} else if (cmd == "bench") {
+			int depth = bench_depth;
+			args >> depth;
+			bench(depth);
+		} else if (cmd == "d") {
+			pos.board.print_board();
+			std::cout << std::flush;
+		} else if (cmd == "quit") {
+			break;
+		} else if (!cmd.empty()) {
+			std::cout << "info string unknown command " << cmd << std::endl;
+		}
+	}
+	return 0;
+}
+
+// perftree protocol: "<move> <count>" per root move, a blank line and the total.
+static int perftree(int depth, const std::string& fen, const std::string& moves) {
+	Position pos;
+	std::istringstream move_list(moves);
+	std::string move;
+	try {
+		pos.load_fen(fen);
+		while (move_list >> move) pos.play_move(move);
+	} catch (const std::invalid_argument& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+
+	std::ostringstream divide;
+	std::streambuf* old = std::cout.rdbuf(divide.rdbuf());
+	NodeCount nodes = count_root(pos, depth, true);
+	std::cout.rdbuf(old);
+
+	std::istringstream lines(divide.str());
+	NodeCount cnt;
+	while (lines >> move >> cnt) std::cout << move.substr(0, move.size() - 1) << ' ' << cnt << '\n';
+	std::cout << '\n' << nodes << std::endl;
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
+	std::ios::sync_with_stdio(false);
+	if (argc >= 2 && std::string(argv[1]) == "bench") return bench(argc > 2 ? std::stoi(argv[2]) : bench_depth);
+	if (argc >= 3) return perftree(std::stoi(argv[1]), argv[2], argc > 3 ? argv[3] : "");
+	return uci_loop();
+}
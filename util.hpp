@@ -5,7 +5,7 @@
 #include <iostream>
 #include <string>
 
-#include "move.hpp"
+#include "defaults.hpp"
 
 #ifndef UTIL_H
 #define UTIL_H
@@ -51,6 +51,14 @@ static inline void print_movecnt(Square start_square, Square end_square, uint64_
 				  << '\n';
 }
 
+// Same as above for promotions, with the promotion piece appended in lowercase.
+static inline void print_movecnt(Square start_square, Square end_square, uint64_t cnt, Piece promotion) {
+	constexpr char promotion_chars[] = " pkrbnq";
+	if (cnt)
+		std::cout << make_chess_notation(start_square) << make_chess_notation(end_square)
+				  << promotion_chars[promotion] << ": " << std::to_string(cnt) << '\n';
+}
+
 inline void print_bitboard(uint64_t bitboard) {
 	printf("\n");
 	// loop over board ranks.
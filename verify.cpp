@@ -0,0 +1,271 @@
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "mate.hpp"
+#include "movegen.hpp"
+#include "packed_position.hpp"
+#include "playout.hpp"
+#include "perft.hpp"
+#include "reference.hpp"
+
+// Differential driver: compares the divide output of count_moves against the reference generator on standard suites
+// and random positions. Mismatches are shrunk to the first diverging move. The move lists of generate_legal_moves are
+// checked against the reference on the same random positions.
+
+struct SuiteEntry {
+	std::string fen;
+	int depth;
+	uint64_t nodes;
+};
+
+// Standard perft positions, including ep, castling and promotion edge cases.
+const std::vector<SuiteEntry> perft_suite = {
+	{"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 4865609},
+	{"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603},
+	{"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624},
+	{"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 422333},
+	{"r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1", 4, 422333},
+	{"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 3, 62379},
+	{"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594},
+	{"3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1", 6, 1134888},
+	{"8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1", 6, 1015133},
+	{"8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1", 6, 1440467},
+	{"5k2/8/8/8/8/8/8/4K2R w K - 0 1", 6, 661072},
+	{"3k4/8/8/8/8/8/8/R3K3 w Q - 0 1", 6, 803711},
+	{"r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1", 4, 1274206},
+	{"r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1", 4, 1720476},
+	{"2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1", 6, 3821001},
+	{"8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1", 5, 1004658},
+	{"4k3/1P6/8/8/8/8/K7/8 w - - 0 1", 6, 217342},
+	{"8/P1k5/K7/8/8/8/8/8 w - - 0 1", 6, 92683},
+	{"K1k5/8/P7/8/8/8/8/8 w - - 0 1", 6, 2217},
+	{"8/k1P5/8/1K6/8/8/8/8 w - - 0 1", 7, 567584},
+	{"8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1", 4, 23527},
+};
+
+// Runs count_moves in divide mode and parses its per move output.
+static std::map<std::string, uint64_t> pyke_divide(const std::string& fen, int depth) {
+	Position pos;
+	pos.load_fen(fen);
+	std::ostringstream out;
+	std::streambuf* old = std::cout.rdbuf(out.rdbuf());
+	count_root(pos, depth, true);
+	std::cout.rdbuf(old);
+
+	std::map<std::string, uint64_t> ret;
+	std::istringstream in(out.str());
+	std::string move;
+	uint64_t cnt;
+	while (in >> move >> cnt) ret[move.substr(0, move.size() - 1)] += cnt;
+	return ret;
+}
+
+static uint64_t total(const std::map<std::string, uint64_t>& divide) {
+	uint64_t ret = 0;
+	for (auto& [move, cnt] : divide) ret += cnt;
+	return ret;
+}
+
+// Compares both generators at the given depth. On a mismatch, follows the first diverging move down until the
+// difference is a missing or extra move at depth 1, or a count that differs without any differing child.
+static bool verify_position(const std::string& fen, int depth) {
+	RefPosition ref;
+	ref.load_fen(fen);
+	std::vector<std::string> path;
+
+	for (int d = depth; d > 0; d--) {
+		std::map<std::string, uint64_t> expected = ref_divide(ref, d);
+		std::map<std::string, uint64_t> actual = pyke_divide(ref.fen(), d);
+		if (expected == actual) {
+			if (path.empty()) return true;
+			std::cout << "MISMATCH " << fen << " depth " << depth << "\n  path:";
+			for (auto& m : path) std::cout << ' ' << m;
+			std::cout << "\n  " << ref.fen() << ": divide matches at depth " << d
+					  << " but the parent count differs\n";
+			return false;
+		}
+
+		// Missing and extra root moves are reported right away, otherwise the first move with a different count.
+		std::string diverging;
+		for (auto& [move, cnt] : expected) {
+			if (!actual.count(move)) diverging = move;
+		}
+		for (auto& [move, cnt] : actual) {
+			if (!expected.count(move)) diverging = move;
+		}
+		for (auto& [move, cnt] : expected) {
+			if (diverging.empty() && actual.at(move) != cnt) diverging = move;
+		}
+
+		bool missing = !actual.count(diverging);
+		bool extra = !expected.count(diverging);
+		if (d == 1 || missing || extra) {
+			std::cout << "MISMATCH " << fen << " depth " << depth << "\n  path:";
+			for (auto& m : path) std::cout << ' ' << m;
+			std::cout << "\n  " << ref.fen() << " at depth " << d << ": " << diverging
+					  << (missing ? " missing in pyke"
+						  : extra ? " extra in pyke"
+								  : " pyke " + std::to_string(actual.at(diverging)) + ", reference "
+									  + std::to_string(expected.at(diverging)))
+					  << " (totals " << total(actual) << " vs " << total(expected) << ")\n";
+			return false;
+		}
+
+		for (const RefMove& m : ref.legal_moves()) {
+			if (m.to_string() != diverging) continue;
+			ref = ref.make(m);
+			break;
+		}
+		path.push_back(diverging);
+	}
+	return true;
+}
+
+// Walks the tree with generate_legal_moves and make_move, comparing every move list and the playout move count against
+// the reference and checking that unmake_move restores the position. The checking moves of the mate solver must be the
+// legal moves that leave the opponent in check.
+static bool verify_movegen(Position& pos, const RefPosition& ref, int depth) {
+	MoveBuffer moves;
+	pyke::generate_legal_moves(pos, moves);
+	std::vector<std::string> actual, expected;
+	for (Move m : moves) actual.push_back(m.to_string());
+	for (const RefMove& m : ref.legal_moves()) expected.push_back(m.to_string());
+	std::sort(actual.begin(), actual.end());
+	std::sort(expected.begin(), expected.end());
+	if (pyke::count_choices(pos) != expected.size()) {
+		std::cout << "PLAYOUT CHOICES MISMATCH " << ref.fen() << ": " << pyke::count_choices(pos) << " moves, reference "
+				  << expected.size() << '\n';
+		return false;
+	}
+	if (actual != expected) {
+		std::cout << "MOVEGEN MISMATCH " << ref.fen() << ": " << actual.size() << " moves, reference "
+				  << expected.size() << '\n';
+		return false;
+	}
+
+	std::vector<std::string> checks, expected_checks;
+	pyke::generate_checks(pos, moves);
+	for (Move m : moves) checks.push_back(m.to_string());
+	pyke::generate_legal_moves(pos, moves);
+	for (Move m : moves) {
+		MoveUndo undo = pyke::make_move(pos, m);
+		if (pyke::side_in_check(pos)) expected_checks.push_back(m.to_string());
+		pyke::unmake_move(pos, m, undo);
+	}
+	std::sort(checks.begin(), checks.end());
+	std::sort(expected_checks.begin(), expected_checks.end());
+	if (checks != expected_checks) {
+		std::cout << "CHECKS MISMATCH " << ref.fen() << ": " << checks.size() << " checks, expected "
+				  << expected_checks.size() << '\n';
+		return false;
+	}
+	if (depth <= 1) return true;
+
+	PackedPosition before = pack_position(pos);
+	for (Move m : moves) {
+		RefPosition child;
+		for (const RefMove& r : ref.legal_moves()) {
+			if (r.to_string() == m.to_string()) child = ref.make(r);
+		}
+		MoveUndo undo = pyke::make_move(pos, m);
+		bool ok = verify_movegen(pos, child, depth - 1);
+		pyke::unmake_move(pos, m, undo);
+		if (!(pack_position(pos) == before)) {
+			std::cout << "UNMAKE MISMATCH " << ref.fen() << ": " << m.to_string() << '\n';
+			return false;
+		}
+		if (!ok) return false;
+	}
+	return true;
+}
+
+static bool verify_movegen(const std::string& fen, int depth) {
+	Position pos;
+	pos.load_fen(fen);
+	RefPosition ref;
+	ref.load_fen(fen);
+	return verify_movegen(pos, ref, depth);
+}
+
+// Plays random legal moves from the start FEN. Returns an empty string if the game ends on the way.
+static std::string random_walk(const std::string& fen, int plies, std::mt19937_64& rng) {
+	RefPosition ref;
+	ref.load_fen(fen);
+	for (int i = 0; i < plies; i++) {
+		std::vector<RefMove> moves = ref.legal_moves();
+		if (moves.empty()) return "";
+		ref = ref.make(moves[rng() % moves.size()]);
+	}
+	return ref.legal_moves().empty() ? "" : ref.fen();
+}
+
+int main(int argc, char* argv[]) {
+	int random_count = 200;
+	int random_depth = 3;
+	int max_plies = 40;
+	uint64_t seed = std::random_device{}();
+	bool run_suite = true;
+	std::string single_fen;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--random" && i + 1 < argc) {
+			random_count = std::stoi(argv[++i]);
+		} else if (arg == "--depth" && i + 1 < argc) {
+			random_depth = std::stoi(argv[++i]);
+		} else if (arg == "--plies" && i + 1 < argc) {
+			max_plies = std::max(1, std::stoi(argv[++i]));
+		} else if (arg == "--seed" && i + 1 < argc) {
+			seed = std::stoull(argv[++i]);
+		} else if (arg == "--no-suite") {
+			run_suite = false;
+		} else if (arg == "--fen" && i + 1 < argc) {
+			single_fen = argv[++i];
+		} else {
+			std::cout << "Usage: verify [--random N] [--depth D] [--plies N] [--seed N] [--no-suite] [--fen FEN]\n";
+			return 1;
+		}
+	}
+
+	int failures = 0;
+	if (!single_fen.empty()) {
+		bool ok = verify_position(single_fen, random_depth);
+		std::cout << (ok ? "OK" : "FAILED") << '\n';
+		return ok ? 0 : 1;
+	}
+
+	if (run_suite) {
+		for (const SuiteEntry& e : perft_suite) {
+			Position pos;
+			pos.load_fen(e.fen);
+			uint64_t nodes = count_root(pos, e.depth);
+			bool ok = nodes == e.nodes;
+			std::cout << (ok ? "ok   " : "FAIL ") << e.fen << " depth " << e.depth << ": " << nodes;
+			if (!ok) std::cout << ", expected " << e.nodes;
+			std::cout << '\n';
+			if (!ok) {
+				verify_position(e.fen, std::min(e.depth, 4));
+				failures++;
+			}
+		}
+	}
+
+	std::mt19937_64 rng(seed);
+	std::cout << "Verifying " << random_count << " random positions at depth " << random_depth << " (seed " << seed
+			  << ")\n";
+	for (int i = 0; i < random_count; i++) {
+		std::string fen = random_walk(perft_suite[rng() % perft_suite.size()].fen, 1 + rng() % max_plies, rng);
+		if (fen.empty()) continue;
+		if (!verify_position(fen, random_depth)) failures++;
+		if (!verify_movegen(fen, std::min(random_depth, 2))) failures++;
+	}
+
+	std::cout << (failures ? "FAILED: " + std::to_string(failures) + " mismatches" : "All positions match") << '\n';
+	return failures ? 1 : 0;
+}
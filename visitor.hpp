@@ -0,0 +1,63 @@
+#include <concepts>
+#include <cstdint>
+
+#include "defaults.hpp"
+#include "position.hpp"
+#include "util.hpp"
+
+#ifndef VISITOR_H
+#define VISITOR_H
+
+// Policy of a tree walk in pyke.hpp. The walk calls the hooks as static functions, so a visitor that does nothing
+// compiles to the plain count. State of a visitor goes in a thread_local pointer, as the hooks take no object.
+//
+//   Child                        policy of the children, e.g. to act at the root only.
+//   bulk                         count the moves of nodes at depth 1 with popcount, without making them. Visitors
+//                                that look at leaves set it to false.
+//   enter<white, cr, ep>(pos, depth)          on entering a node with moves left, before its moves are generated.
+//   leave<white, cr, ep>(pos, depth, nodes)   on leaving it, with the leaves counted below it.
+//   leaf<white, cr, ep>(pos)                  at the leaves, returns what the leaf adds to the count.
+//   moved(from, to, promotion, nodes)         after each move of the node, with the leaves counted below it.
+//
+// white, cr and ep are the side to move, castling rights and whether pos.ep_flag is live. The board and king squares
+// of pos are current; white_turn, castling_rights and ep_flag are not kept up to date during the walk.
+template <typename V>
+concept TreeVisitor = requires(Position& pos, Square sq, Piece p, NodeCount n) {
+	typename V::Child;
+	{ V::bulk } -> std::convertible_to<bool>;
+	V::template enter<true, 0, false>(pos, 1);
+	V::template leave<true, 0, false>(pos, 1, n);
+	{ V::template leaf<true, 0, false>(pos) } -> std::convertible_to<NodeCount>;
+	V::moved(sq, sq, p, n);
+};
+
+// Plain leaf count.
+struct CountLeaves {
+	using Child = CountLeaves;
+	static constexpr bool bulk = true;
+
+	template <bool white, CastlingRights cr, bool ep>
+	static inline void enter(Position&, int) {}
+	template <bool white, CastlingRights cr, bool ep>
+	static inline void leave(Position&, int, NodeCount) {}
+	template <bool white, CastlingRights cr, bool ep>
+	static inline NodeCount leaf(Position&) {
+		return 1;
+	}
+	static inline void moved(Square, Square, Piece, NodeCount) {}
+};
+
+// Leaf count that prints the count of every root move.
+struct DivideLeaves : CountLeaves {
+	using Child = CountLeaves;
+	static constexpr bool bulk = false;
+
+	static inline void moved(Square from, Square to, Piece promotion, NodeCount nodes) {
+		if (promotion == EMPTY)
+			print_movecnt(from, to, nodes);
+		else
+			print_movecnt(from, to, nodes, promotion);
+	}
+};
+
+#endif
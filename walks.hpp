@@ -0,0 +1,83 @@
+#include <cstdint>
+#include <vector>
+
+#include "packed_position.hpp"
+#include "perft.hpp"
+#include "pyke.hpp"
+#include "visitor.hpp"
+
+#ifndef WALKS_H
+#define WALKS_H
+
+// Custom tree walks built on the visitor hooks of count_moves.
+
+// Predicates on leaves, for CountIf and CollectIf.
+struct AnyLeaf {
+	template <bool white, CastlingRights cr, bool ep>
+	static inline bool test(Position&) {
+		return true;
+	}
+};
+
+struct InCheck {
+	template <bool white, CastlingRights cr, bool ep>
+	static inline bool test(Position& pos) {
+		return pos.is_attacked<white>(pos.get_ksq<white>());
+	}
+};
+
+struct Checkmate {
+	template <bool white, CastlingRights cr, bool ep>
+	static inline bool test(Position& pos) {
+		return pos.is_attacked<white>(pos.get_ksq<white>()) && !pyke::has_legal_move<white, ep>(pos);
+	}
+};
+
+// Counts the leaves that satisfy the predicate.
+template <typename Predicate>
+struct CountIf : CountLeaves {
+	using Child = CountIf;
+	static constexpr bool bulk = false;
+
+	template <bool white, CastlingRights cr, bool ep>
+	static inline NodeCount leaf(Position& pos) {
+		return Predicate::template test<white, cr, ep>(pos);
+	}
+};
+
+// Counts the leaves that satisfy the predicate and appends them to *out, once per move path that reaches them.
+template <typename Predicate>
+struct CollectIf : CountLeaves {
+	using Child = CollectIf;
+	static constexpr bool bulk = false;
+	static inline thread_local std::vector<PackedPosition>* out = nullptr;
+
+	template <bool white, CastlingRights cr, bool ep>
+	static inline NodeCount leaf(Position& pos) {
+		if (!Predicate::template test<white, cr, ep>(pos)) return 0;
+		// The walk keeps these in template arguments, the packed position needs them set.
+		bool white_turn = pos.white_turn;
+		CastlingRights castling_rights = pos.castling_rights;
+		uint8_t ep_flag = pos.ep_flag;
+		pos.white_turn = white;
+		pos.castling_rights = cr;
+		pos.ep_flag = ep ? ep_flag : 0;
+		out->push_back(pack_position(pos));
+		pos.white_turn = white_turn;
+		pos.castling_rights = castling_rights;
+		pos.ep_flag = ep_flag;
+		return 1;
+	}
+};
+
+// Positions ply plies below pos that satisfy the predicate, once per move path. Restores pos.
+template <typename Predicate = AnyLeaf, int max_depth = 5>
+static std::vector<PackedPosition> collect_leaves(Position& pos, int ply) {
+	std::vector<PackedPosition> ret;
+	CollectIf<Predicate>::out = &ret;
+	walk<CollectIf<Predicate>, max_depth>(pos, ply);
+	CollectIf<Predicate>::out = nullptr;
+	return ret;
+}
+
+#endif
@@ -0,0 +1,55 @@
+#include <array>
+#include <cstdint>
+
+#include "board.hpp"
+#include "defaults.hpp"
+#include "position.hpp"
+#include "util.hpp"
+
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+// Zobrist keys, generated at compile time with splitmix64. Indexed by color, piece - 1 and square, followed by the
+// castling rights, the ep flag and the side to move.
+struct ZobristKeys {
+	uint64_t pieces[2][6][64];
+	uint64_t castling[16];
+	uint64_t ep[256];
+	uint64_t black_to_move;
+};
+
+inline constexpr ZobristKeys zobrist_keys = [] {
+	ZobristKeys keys{};
+	uint64_t state = 0x5eed5eed5eed5eedULL;
+	auto next = [&state] {
+		uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	};
+	for (auto& color : keys.pieces) {
+		for (auto& piece : color) {
+			for (auto& key : piece) key = next();
+		}
+	}
+	for (auto& key : keys.castling) key = next();
+	for (auto& key : keys.ep) key = next();
+	keys.ep[0] = 0;
+	keys.black_to_move = next();
+	return keys;
+}();
+
+// Key of a position, computed from scratch.
+static inline uint64_t zobrist_key(Position& pos) {
+	uint64_t key = zobrist_keys.castling[pos.castling_rights] ^ zobrist_keys.ep[pos.ep_flag];
+	if (!pos.white_turn) key ^= zobrist_keys.black_to_move;
+	for (int white = 0; white < 2; white++) {
+		for (Piece p = PAWN; p <= QUEEN; p++) {
+			BitBoard b = *pos.board.get_board_pointer(white, p);
+			while (b) key ^= zobrist_keys.pieces[white][p - 1][pop(b)];
+		}
+	}
+	return key;
+}
+
+#endif